@@ -0,0 +1,124 @@
+#include "ClockFace.hpp"
+
+//----------------------------------------------------------------------------------------
+// Face description
+
+// Ring geometry (LED at 12 o'clock, direction) is in ClockFace.hpp
+static constexpr RingGeometry OUTER = ClockFace::OUTER_RING;
+static constexpr RingGeometry INNER = ClockFace::INNER_RING;
+
+struct Color {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+
+static constexpr Color TICK = { 0, 20, 0 };     // Green ticks at 12, 3, 6 and 9
+static constexpr uint TICKS = 4;
+
+// Minute hand: 2 LEDs per 5 minutes, the minutes in between cross-fade to the next LED
+static constexpr uint8_t MINUTE_HIGH = 64;
+static constexpr uint8_t MINUTE_RAMP[5][2] = {
+    { MINUTE_HIGH, 0 },
+    { 20, 1 },
+    { 15, 2 },
+    { 2, 15 },
+    { 1, 20 },
+};
+
+// Hour hand: 2 LEDs per hour, one LED further after half past. The next LED glows
+// dimly to show the quarter (none at the full quarters and the first minute).
+static constexpr uint8_t HOUR_HIGH = 64;
+static constexpr uint HOUR_LOW_STATES = 3;
+static constexpr uint8_t HOUR_LOW[HOUR_LOW_STATES] = { 0, 1, 2 };
+
+static constexpr uint hourLowState(uint minutes) {
+    return ((minutes > 1 && minutes < 15) || (minutes > 30 && minutes < 45)) ? 1
+         : ((minutes > 15 && minutes < 30) || (minutes > 45)) ? 2
+         : 0;
+}
+
+static constexpr uint hourHalfStep(uint minutes) {
+    return minutes > 30 ? 1 : 0;
+}
+
+//----------------------------------------------------------------------------------------
+// Frame generator
+
+struct Frame {
+    uint8_t bytes[ClockFace::FRAME_BYTES];
+};
+
+static constexpr uint8_t saturate(uint v) {
+    return v > 255 ? 255 : v;
+}
+
+// Hands are added to the ticks, saturating per channel
+static constexpr void add(Frame &frame, uint led, Color color) {
+    uint8_t *p = &frame.bytes[led * 3];
+    p[0] = saturate(p[0] + color.green);
+    p[1] = saturate(p[1] + color.red);
+    p[2] = saturate(p[2] + color.blue);
+}
+
+static constexpr Frame ticks(const RingGeometry &ring) {
+    Frame frame = {};
+    for (uint t = 0; t < TICKS; t++) {
+        add(frame, ring.led(t * ClockFace::RING_LEDS / TICKS), TICK);
+    }
+    return frame;
+}
+
+struct OuterFrames {
+    Frame frames[60];
+};
+
+static constexpr OuterFrames makeOuter() {
+    OuterFrames table = {};
+    for (uint m = 0; m < 60; m++) {
+        Frame frame = ticks(OUTER);
+        uint step = 2 * (m / 5);
+        add(frame, OUTER.led(step), { 0, 0, MINUTE_RAMP[m % 5][0] });
+        if (MINUTE_RAMP[m % 5][1]) {
+            add(frame, OUTER.led(step + 1), { 0, 0, MINUTE_RAMP[m % 5][1] });
+        }
+        table.frames[m] = frame;
+    }
+    return table;
+}
+
+// Indexed by hour, half step and low state, not by minute: 72 frames instead of 720
+struct InnerFrames {
+    Frame frames[12][2][HOUR_LOW_STATES];
+};
+
+static constexpr InnerFrames makeInner() {
+    InnerFrames table = {};
+    for (uint h = 0; h < 12; h++) {
+        for (uint half = 0; half < 2; half++) {
+            for (uint low = 0; low < HOUR_LOW_STATES; low++) {
+                Frame frame = ticks(INNER);
+                uint step = 2 * h + half;
+                add(frame, INNER.led(step), { HOUR_HIGH, 0, 0 });
+                if (HOUR_LOW[low]) {
+                    add(frame, INNER.led(step + 1), { HOUR_LOW[low], 0, 0 });
+                }
+                table.frames[h][half][low] = frame;
+            }
+        }
+    }
+    return table;
+}
+
+// Generated by the compiler, placed in flash
+static constexpr OuterFrames outerFrames = makeOuter();
+static constexpr InnerFrames innerFrames = makeInner();
+
+const uint8_t *ClockFace::outer(uint minutes) {
+    return outerFrames.frames[minutes % 60].bytes;
+}
+
+const uint8_t *ClockFace::inner(uint hours, uint minutes) {
+    minutes %= 60;
+    return innerFrames.frames[hours % 12][hourHalfStep(minutes)][hourLowState(minutes)].bytes;
+}
@@ -0,0 +1,31 @@
+#ifndef CLOCK_FACE_H
+#define CLOCK_FACE_H
+
+#include "pico/types.h"
+#include "RingGeometry.hpp"
+
+/**
+ * Precomputed frames of the two ring clock face.
+ *
+ * The face is described declaratively in ClockFace.cpp (ring size, where 12 o'clock is, ticks,
+ * hand colors and intensity ramps) and a constexpr generator turns it into every frame the rings
+ * can show at compile time. The frames live in flash, packed in wire order (GRB), ready for
+ * WS2812::showFrame(), so showing a time is a table lookup and one DMA.
+ */
+class ClockFace {
+    public:
+        static const uint RING_LEDS = 24;
+        static const uint FRAME_BYTES = RING_LEDS * 3;
+
+        // The inner ring is mounted 3 LEDs rotated against the outer one due to the mounting holes
+        static constexpr RingGeometry OUTER_RING = RingGeometry::withTop(RING_LEDS, 18);
+        static constexpr RingGeometry INNER_RING = RingGeometry::withTop(RING_LEDS, 18 - 3);
+
+        // Outer ring: minute hand
+        static const uint8_t *outer(uint minutes);
+
+        // Inner ring: hour hand, moves half a step after half past and shows the quarters dimly
+        static const uint8_t *inner(uint hours, uint minutes);
+};
+
+#endif
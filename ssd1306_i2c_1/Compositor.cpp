@@ -0,0 +1,151 @@
+#include <string.h>
+
+#include "Compositor.hpp"
+
+// SWAR helpers: a pixel is split into 0x00BB00RR and 0x00AA00GG, each 16-bit lane has room for a product
+#define LANES 0x00FF00FFu
+#define LANES_CARRY 0x01000100u
+
+// Alpha blend: dst + (src - dst) * a, done as (src * a + dst * (256 - a)) >> 8 for two lanes at once.
+// The alpha lane is blended along with green and dropped, blended pixels carry no alpha.
+static inline uint32_t blendOver(uint32_t dst, uint32_t src) {
+    uint32_t a = src >> 24;
+    a += a >> 7;                // 0..255 -> 0..256, so 255 gives exactly src
+    uint32_t na = 256 - a;
+
+    uint32_t rb = (((src & LANES) * a + (dst & LANES) * na) >> 8) & LANES;
+    uint32_t ag = ((((src >> 8) & LANES) * a + ((dst >> 8) & LANES) * na) >> 8) & LANES;
+    return rb | ((ag & 0xFF) << 8);
+}
+
+// Saturating add of src scaled by alpha, the carry out of each lane turns into 0xFF
+static inline uint32_t blendAdd(uint32_t dst, uint32_t src) {
+    uint32_t a = src >> 24;
+    a += a >> 7;
+
+    uint32_t rb = ((((src & LANES) * a) >> 8) & LANES) + (dst & LANES);
+    uint32_t ag = (((((src >> 8) & LANES) * a) >> 8) & LANES) + ((dst >> 8) & LANES);
+
+    uint32_t carry = rb & LANES_CARRY;
+    rb |= carry - (carry >> 8);
+    carry = ag & LANES_CARRY;
+    ag |= carry - (carry >> 8);
+    return (rb & LANES) | ((ag & 0xFF) << 8);
+}
+
+Compositor::Compositor(uint length) {
+    this->length = length;
+    this->layers = new uint32_t[LAYER_COUNT * length];
+    this->blended = new uint32_t[LAYER_COUNT * length];
+    memset(layers, 0, LAYER_COUNT * length * sizeof(uint32_t));
+    memset(blended, 0, LAYER_COUNT * length * sizeof(uint32_t));
+    for (uint l = 0; l < LAYER_COUNT; l++) {
+        modes[l] = BLEND_OVER;
+    }
+    for (uint l = 0; l < LAYER_COUNT; l++) {
+        hashes[l] = hashLayer(l);
+    }
+    dirtyFrom = 0;
+    touched = 0;
+}
+
+Compositor::~Compositor() {
+    delete[] layers;
+    delete[] blended;
+}
+
+void Compositor::markDirty(uint layer) {
+    if (layer < dirtyFrom) {
+        dirtyFrom = layer;
+    }
+}
+
+// FNV-1a, same as WS2812 uses for its frames
+uint32_t Compositor::hashLayer(uint layer) {
+    const uint32_t *p = &layers[layer * length];
+    uint32_t hash = 2166136261u;
+    for (uint i = 0; i < length; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void Compositor::setBlendMode(Layer layer, BlendMode mode) {
+    if (modes[layer] != mode) {
+        modes[layer] = mode;
+        markDirty(layer);
+    }
+}
+
+void Compositor::setPixel(Layer layer, uint index, uint32_t color, uint8_t alpha) {
+    if (index >= length) {
+        return;
+    }
+    uint32_t pixel = (uint32_t)(alpha) << 24 | (color & 0x00FFFFFF);
+    uint32_t *p = &layers[layer * length + index];
+    if (*p != pixel) {
+        *p = pixel;
+        touched |= 1u << layer;
+    }
+}
+
+void Compositor::clearLayer(Layer layer) {
+    uint32_t *p = &layers[layer * length];
+    for (uint i = 0; i < length; i++) {
+        if (p[i]) {
+            p[i] = 0;
+            touched |= 1u << layer;
+        }
+    }
+}
+
+void Compositor::setFrame(Layer layer, const uint8_t *frame) {
+    for (uint i = 0; i < length; i++) {
+        const uint8_t *p = &frame[i * 3];
+        uint32_t color = WS2812::RGB(p[1], p[0], p[2]);
+        setPixel(layer, i, color, color ? 255 : 0);
+    }
+}
+
+bool Compositor::compose(WS2812 &strip) {
+    // Written layers are dirty only when they ended up different from what was blended last time
+    for (uint l = 0; touched; l++, touched >>= 1) {
+        if (touched & 1) {
+            uint32_t hash = hashLayer(l);
+            if (hash != hashes[l]) {
+                hashes[l] = hash;
+                markDirty(l);
+            }
+        }
+    }
+
+    bool changed = dirtyFrom < LAYER_COUNT;
+    for (uint l = dirtyFrom; l < LAYER_COUNT; l++) {
+        const uint32_t *src = &layers[l * length];
+        uint32_t *out = &blended[l * length];
+        if (l == 0) {
+            // Bottom layer is blended over black
+            for (uint i = 0; i < length; i++) {
+                out[i] = (modes[0] == BLEND_OVER ? blendOver(0, src[i]) : blendAdd(0, src[i]));
+            }
+            continue;
+        }
+        const uint32_t *below = &blended[(l - 1) * length];
+        if (modes[l] == BLEND_OVER) {
+            for (uint i = 0; i < length; i++) {
+                out[i] = (src[i] >> 24) ? blendOver(below[i], src[i]) : below[i];
+            }
+        } else {
+            for (uint i = 0; i < length; i++) {
+                out[i] = (src[i] >> 24) ? blendAdd(below[i], src[i]) : below[i];
+            }
+        }
+    }
+    dirtyFrom = LAYER_COUNT;
+
+    const uint32_t *result = &blended[(LAYER_COUNT - 1) * length];
+    for (uint i = 0; i < length; i++) {
+        strip.setPixelColor(i, result[i]);
+    }
+    return changed;
+}
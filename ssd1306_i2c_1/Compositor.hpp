@@ -0,0 +1,61 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include "WS2812.hpp"
+
+/**
+ * Ordered pixel layers blended into one LED strip.
+ *
+ * Layer pixels are 0xAABBGGRR words: WS2812::RGB() color with the per-pixel alpha in the top byte.
+ * Blending works on two channels per 32-bit operation (R+B and G+A lanes of 16 bits).
+ * Only layers whose content changed since the last compose() are blended again, the layers below them
+ * are cached. Clearing a layer and drawing the same pixels again does not count as a change.
+ * A layer can also take a complete precomputed frame, e.g. the clock face from ClockFace.
+ */
+class Compositor {
+    public:
+        enum Layer {
+            LAYER_TICKS=0,      // Background hour ticks, or the whole precomputed face
+            LAYER_HOUR=1,
+            LAYER_MINUTE=2,
+            LAYER_SECONDS=3,
+            LAYER_EFFECTS=4,    // Transient effects
+            LAYER_COUNT=5
+        };
+        enum BlendMode {
+            BLEND_OVER=0,       // Alpha blend over the layers below
+            BLEND_ADD=1         // Add color scaled by alpha, saturating at 255
+        };
+
+        Compositor(uint length);
+        ~Compositor();
+
+        static uint32_t RGBA(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) {
+            return (uint32_t)(alpha) << 24 | WS2812::RGB(red, green, blue);
+        }
+
+        void setBlendMode(Layer layer, BlendMode mode);
+        void setPixel(Layer layer, uint index, uint32_t color, uint8_t alpha = 255);
+        void clearLayer(Layer layer);
+
+        // Loads a packed GRB frame (see ClockFace) into a layer, lit pixels are opaque, dark ones transparent
+        void setFrame(Layer layer, const uint8_t *frame);
+
+        // Blends the dirty layers and writes the result into the strip, returns false when it did not change.
+        // The result is written either way, the strip may have been drawn on directly since.
+        bool compose(WS2812 &strip);
+
+    private:
+        uint length;
+        uint32_t *layers;       // LAYER_COUNT x length pixels
+        uint32_t *blended;      // Result of layers 0..n for every n, so clean layers need no blending
+        BlendMode modes[LAYER_COUNT];
+        uint dirtyFrom;         // Lowest dirty layer, LAYER_COUNT when clean
+        uint32_t touched;       // Layers written since the last compose(), bit per layer
+        uint32_t hashes[LAYER_COUNT];   // Layer content at the last compose()
+
+        void markDirty(uint layer);
+        uint32_t hashLayer(uint layer);
+};
+
+#endif
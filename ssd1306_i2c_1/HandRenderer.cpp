@@ -0,0 +1,33 @@
+#include "HandRenderer.hpp"
+
+static inline uint8_t addScaled(uint8_t value, uint8_t channel, uint scale) {
+    uint v = value + ((channel * scale) >> 8);
+    return v > 255 ? 255 : v;
+}
+
+void HandRenderer::draw(uint8_t *frame, uint16_t angle, uint32_t color) const {
+    const Spread &s = spread(angle);
+    uint8_t red = color & 0xFF;
+    uint8_t green = (color >> 8) & 0xFF;
+    uint8_t blue = (color >> 16) & 0xFF;
+
+    uint weights[2] = { 256u - s.weight, s.weight };
+    uint leds[2] = { s.first, s.second };
+    for (uint i = 0; i < 2; i++) {
+        uint8_t *p = &frame[leds[i] * 3];
+        p[0] = addScaled(p[0], green, weights[i]);
+        p[1] = addScaled(p[1], red, weights[i]);
+        p[2] = addScaled(p[2], blue, weights[i]);
+    }
+}
+
+void HandRenderer::draw(Compositor &compositor, Compositor::Layer layer, uint16_t angle, uint32_t color) const {
+    const Spread &s = spread(angle);
+    uint firstAlpha = 255 - s.weight;
+    if (firstAlpha) {
+        compositor.setPixel(layer, s.first, color, firstAlpha);
+    }
+    if (s.weight) {
+        compositor.setPixel(layer, s.second, color, s.weight);
+    }
+}
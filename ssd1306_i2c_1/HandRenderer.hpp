@@ -0,0 +1,49 @@
+#ifndef HAND_RENDERER_H
+#define HAND_RENDERER_H
+
+#include "RingGeometry.hpp"
+#include "Compositor.hpp"
+
+/**
+ * Anti-aliased clock hand on one ring.
+ *
+ * A hand between two LEDs lights both, weighted by its distance to each, so it moves smoothly
+ * instead of jumping from LED to LED. The LED pair and weight of every angle step are computed
+ * from the ring geometry at compile time (declare the renderer constexpr and the table goes to flash),
+ * drawing a hand is a table lookup and two saturating adds.
+ */
+class HandRenderer {
+    public:
+        static const uint LUT_BITS = 10;    // Angle steps per turn: 1024, ~43 per LED on a 24 LED ring
+
+        struct Spread {
+            uint8_t first;
+            uint8_t second;     // Next LED in index order
+            uint8_t weight;     // Share of the second LED, 0..255
+        };
+
+        constexpr HandRenderer(const RingGeometry &ring) : lut() {
+            uint leds = ring.getLeds();
+            for (uint i = 0; i < (1u << LUT_BITS); i++) {
+                uint32_t p = ring.position((uint16_t)(i << (16 - LUT_BITS)));
+                uint first = (p >> 8) % leds;
+                lut[i].first = first;
+                lut[i].second = (first + 1) % leds;
+                lut[i].weight = p & 0xFF;
+            }
+        }
+
+        // Angles of the same table entry light the same LEDs the same way
+        constexpr const Spread &spread(uint16_t angle) const { return lut[angle >> (16 - LUT_BITS)]; }
+
+        // Adds the hand to a packed GRB frame (see ClockFace), color is WS2812::RGB()
+        void draw(uint8_t *frame, uint16_t angle, uint32_t color) const;
+
+        // Draws the hand into a compositor layer, the weights become the pixel alpha
+        void draw(Compositor &compositor, Compositor::Layer layer, uint16_t angle, uint32_t color) const;
+
+    private:
+        Spread lut[1 << LUT_BITS];
+};
+
+#endif
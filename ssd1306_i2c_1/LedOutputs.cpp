@@ -0,0 +1,116 @@
+#include <stdio.h>
+
+#include "LedOutputs.hpp"
+
+LedOutputs::LedOutputs(const Config *config, uint count) {
+    this->config = config;
+    this->count = MIN(count, MAX_STRIPS);
+}
+
+LedOutputs::~LedOutputs() {
+    for (uint i = 0; i < started; i++) {
+        pio_sm_unclaim(strips[i]->getPio(), strips[i]->getSm());
+        delete strips[i];
+    }
+}
+
+bool LedOutputs::claim(PIO *pio, uint *sm) {
+    PIO pios[2] = { pio0, pio1 };
+    for (uint i = 0; i < 2; i++) {
+        if (!WS2812::canUsePio(pios[i])) {
+            printf("LedOutputs: no program space left in PIO%u\n", i);
+            continue;
+        }
+        int claimed = pio_claim_unused_sm(pios[i], false);
+        if (claimed >= 0) {
+            *pio = pios[i];
+            *sm = (uint) claimed;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint LedOutputs::begin() {
+    // Whatever is claimed now belongs to somebody else (CYW43 SPI, audio, ...)
+    PIO pios[2] = { pio0, pio1 };
+    for (uint i = 0; i < 2; i++) {
+        for (uint sm = 0; sm < 4; sm++) {
+            if (pio_sm_is_claimed(pios[i], sm)) {
+                foreignSms[i] |= 1u << sm;
+                printf("LedOutputs: PIO%u SM%u is already in use (Wi-Fi driver?)\n", i, sm);
+            }
+        }
+    }
+
+    for (started = 0; started < count; started++) {
+        PIO pio;
+        uint sm;
+        if (!claim(&pio, &sm)) {
+            printf("LedOutputs: no free state machine for strip %u at pin %u\n", started, config[started].pin);
+            break;
+        }
+        const Config &c = config[started];
+        strips[started] = new WS2812(c.pin, c.length, pio, sm, c.format, c.storage);
+        smMask[pio_get_index(pio)] |= 1u << sm;
+        printf("LedOutputs: strip %u at pin %u uses PIO%u SM%u\n", started, c.pin, pio_get_index(pio), sm);
+    }
+
+    // WS2812 enables its SM right away, restart them all together so their clock dividers run in phase
+    for (uint i = 0; i < 2; i++) {
+        if (smMask[i]) {
+            pio_set_sm_mask_enabled(pios[i], smMask[i], false);
+        }
+    }
+    enableInSync(smMask);
+
+    return started;
+}
+
+void LedOutputs::enableInSync(const uint32_t mask[2]) {
+    // Each PIO block starts its mask on one clock edge, the two blocks follow each other within a few cycles
+    if (mask[0]) {
+        pio_enable_sm_mask_in_sync(pio0, mask[0]);
+    }
+    if (mask[1]) {
+        pio_enable_sm_mask_in_sync(pio1, mask[1]);
+    }
+}
+
+void LedOutputs::show() {
+    show(nullptr);
+}
+
+void LedOutputs::show(const uint8_t *const frames[]) {
+    bool pending[MAX_STRIPS] = {};
+    uint32_t paused[2] = {};
+
+    // Packed strips are fed by DMA: hold their SMs, let the DMA preload the FIFOs and release them together
+    for (uint i = 0; i < started; i++) {
+        if (strips[i]->isPacked()) {
+            strips[i]->waitIdle();
+            paused[pio_get_index(strips[i]->getPio())] |= 1u << strips[i]->getSm();
+        }
+    }
+    if (paused[0]) {
+        pio_set_sm_mask_enabled(pio0, paused[0], false);
+    }
+    if (paused[1]) {
+        pio_set_sm_mask_enabled(pio1, paused[1], false);
+    }
+
+    for (uint i = 0; i < started; i++) {
+        if (strips[i]->isPacked()) {
+            pending[i] = (frames ? strips[i]->beginShowFrame(frames[i]) : strips[i]->beginShow());
+        }
+    }
+    enableInSync(paused);
+
+    for (uint i = 0; i < started; i++) {
+        if (pending[i]) {
+            strips[i]->endShow();
+        } else if (!strips[i]->isPacked()) {
+            strips[i]->show();
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef LED_OUTPUTS_H
+#define LED_OUTPUTS_H
+
+#include "WS2812.hpp"
+
+/**
+ * Owns all WS2812 strips of the project.
+ *
+ * State machines are claimed with pio_claim_unused_sm() instead of hardcoded indexes, so they
+ * never collide with the CYW43 driver, which claims its own SM (PIO1 if there is space, else PIO0).
+ * begin() must therefore be called after cyw43_arch_init().
+ */
+class LedOutputs {
+    public:
+        struct Config {
+            uint pin;
+            uint length;
+            WS2812::DataFormat format;
+            WS2812::Storage storage;
+        };
+
+        static const uint MAX_STRIPS = 8;  // 4 state machines per PIO block
+
+        LedOutputs(const Config *config, uint count);
+        ~LedOutputs();
+
+        // Claims state machines, creates the strips and starts them in sync.
+        // Returns the number of strips started, less than count when there were not enough free SMs.
+        uint begin();
+
+        uint getCount() { return started; }
+        WS2812 &strip(uint index) { return *strips[index]; }
+
+        // Pushes all strips, packed strips on one PIO block start on the same clock edge
+        void show();
+
+        // Same with a packed frame per strip (see WS2812::showFrame()), for example straight from flash
+        void show(const uint8_t *const frames[]);
+
+        // State machines that were already claimed before begin(), i.e. used by the Wi-Fi driver or other code
+        uint32_t getForeignSmMask(uint pioIndex) { return foreignSms[pioIndex]; }
+
+    private:
+        const Config *config;
+        uint count;
+        uint started = 0;
+        WS2812 *strips[MAX_STRIPS] = {};
+        uint32_t foreignSms[2] = {};
+        uint32_t smMask[2] = {};    // Our state machines per PIO block
+
+        bool claim(PIO *pio, uint *sm);
+        void enableInSync(const uint32_t mask[2]);
+};
+
+#endif
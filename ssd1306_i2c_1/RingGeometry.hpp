@@ -0,0 +1,56 @@
+#ifndef RING_GEOMETRY_H
+#define RING_GEOMETRY_H
+
+#include "pico/types.h"
+
+/**
+ * Where the LEDs of a ring sit on the dial.
+ *
+ * Angles are fractions of a full turn, 0..65535, clockwise from 12 o'clock. A ring is described by
+ * its LED count, the angle of LED 0 and the direction in which the LED indexes grow, so rings that
+ * are mounted rotated or mirrored need no index juggling in the drawing code.
+ * Everything is constexpr, so ClockFace can generate its frames from the same description.
+ */
+class RingGeometry {
+    public:
+        enum Direction {
+            CLOCKWISE=1,
+            COUNTERCLOCKWISE=-1
+        };
+
+        static const uint32_t TURN = 65536;
+
+        constexpr RingGeometry(uint leds, uint16_t offset, Direction direction = CLOCKWISE)
+            : leds(leds), offset(offset), direction(direction) {}
+
+        // Ring with the given LED at 12 o'clock
+        static constexpr RingGeometry withTop(uint leds, uint top, Direction direction = CLOCKWISE) {
+            return RingGeometry(leds, (uint16_t)(-(int64_t)direction * (top % leds) * TURN / leds), direction);
+        }
+
+        constexpr uint getLeds() const { return leds; }
+
+        // Position of an angle in LED indexes, 8 fractional bits: LED floor(p >> 8) plus (p & 0xFF) / 256 of the next one
+        constexpr uint32_t position(uint16_t angle) const {
+            uint16_t fromLed0 = (uint16_t)(direction == CLOCKWISE ? angle - offset : offset - angle);
+            return ((uint32_t)fromLed0 * leds) >> 8;
+        }
+
+        // LED that is the given number of LED steps clockwise from 12 o'clock
+        constexpr uint led(uint steps) const {
+            uint top = ((position(0) + 128) >> 8) % leds;
+            return direction == CLOCKWISE ? (top + steps) % leds : (top + leds - steps % leds) % leds;
+        }
+
+        // value out of range as an angle, e.g. angle(ms, 60000) for a second hand
+        static constexpr uint16_t angle(uint32_t value, uint32_t range) {
+            return (uint16_t)((uint64_t)(value % range) * TURN / range);
+        }
+
+    private:
+        uint leds;
+        uint16_t offset;        // Angle of LED 0
+        Direction direction;    // Direction of growing LED indexes
+};
+
+#endif
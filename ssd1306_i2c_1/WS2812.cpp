@@ -1,5 +1,10 @@
+#include <string.h>
+
 #include "WS2812.hpp"
 #include "WS2812.pio.h"
+#include "hardware/dma.h"
+#include "pico/time.h"
+#include "pixel_kernels.h"
 
 //#define DEBUG
 
@@ -7,22 +12,27 @@
 #include <stdio.h>
 #endif
 
+int WS2812::programOffset[2] = { -1, -1 };
+WS2812::CaptureHook WS2812::captureHook = nullptr;
+void *WS2812::captureContext = nullptr;
+
 WS2812::WS2812(uint pin, uint length, PIO pio, uint sm)  {
     initialize(pin, length, pio, sm, NONE, GREEN, RED, BLUE);
 }
 
 WS2812::WS2812(uint pin, uint length, PIO pio, uint sm, DataFormat format) {
-    switch (format) {
-        case FORMAT_RGB:
-            initialize(pin, length, pio, sm, NONE, RED, GREEN, BLUE);
-            break;
-        case FORMAT_GRB:
-            initialize(pin, length, pio, sm, NONE, GREEN, RED, BLUE);
-            break;
-        case FORMAT_WRGB:
-            initialize(pin, length, pio, sm, WHITE, RED, GREEN, BLUE);
-            break;
-    }
+    initialize(pin, length, pio, sm, format);
+}
+
+WS2812::WS2812(uint pin, uint length, PIO pio, uint sm, DataFormat format, Storage storage) {
+    this->storage = storage;
+    initialize(pin, length, pio, sm, format);
+}
+
+WS2812::WS2812(uint pin, uint length, PIO pio, uint sm, DataFormat format, PixelGenerator generator, void *context) {
+    this->generator = generator;
+    this->generatorContext = context;
+    initialize(pin, length, pio, sm, format);
 }
 
 WS2812::WS2812(uint pin, uint length, PIO pio, uint sm, DataByte b1, DataByte b2, DataByte b3) {
@@ -34,7 +44,29 @@ WS2812::WS2812(uint pin, uint length, PIO pio, uint sm, DataByte b1, DataByte b2
 }
 
 WS2812::~WS2812() {
-    
+    // The DMA may still be reading the last frame. The streaming ring buffer is static and shared,
+    // giving up the channel is all that ties a strip to it.
+    if (dmaChannel >= 0) {
+        dma_channel_wait_for_finish_blocking(dmaChannel);
+        dma_channel_unclaim(dmaChannel);
+    }
+    delete[] data;
+    delete[] packed;
+    delete[] scaled;
+}
+
+void WS2812::initialize(uint pin, uint length, PIO pio, uint sm, DataFormat format) {
+    switch (format) {
+        case FORMAT_RGB:
+            initialize(pin, length, pio, sm, NONE, RED, GREEN, BLUE);
+            break;
+        case FORMAT_GRB:
+            initialize(pin, length, pio, sm, NONE, GREEN, RED, BLUE);
+            break;
+        case FORMAT_WRGB:
+            initialize(pin, length, pio, sm, WHITE, RED, GREEN, BLUE);
+            break;
+    }
 }
 
 void WS2812::initialize(uint pin, uint length, PIO pio, uint sm, DataByte b1, DataByte b2, DataByte b3, DataByte b4) {
@@ -42,22 +74,106 @@ void WS2812::initialize(uint pin, uint length, PIO pio, uint sm, DataByte b1, Da
     this->length = length;
     this->pio = pio;
     this->sm = sm;
-    this->data = new uint32_t[length];
     this->bytes[0] = b1;
     this->bytes[1] = b2;
     this->bytes[2] = b3;
     this->bytes[3] = b4;
-    uint offset = pio_add_program(pio, &ws2812_program);
+    this->bytesPerPixel = (b1 == NONE ? 3 : 4);
+    if (generator) {
+        // Streaming strips have no frame buffer, pixels come from the generator
+        this->storage = STORAGE_WORD;
+        this->data = nullptr;
+    } else if (storage == STORAGE_PACKED) {
+        this->data = nullptr;
+        this->packed = new uint8_t[length * bytesPerPixel];
+    } else {
+        this->data = new uint32_t[length];
+    }
+    // All strips on one PIO block share a single copy of the program
+    uint index = pio_get_index(pio);
+    if (programOffset[index] < 0) {
+        programOffset[index] = pio_add_program(pio, &ws2812_program);
+    }
+    uint offset = programOffset[index];
     uint bits = (b1 == NONE ? 24 : 32);
+    if (storage == STORAGE_PACKED) {
+        // Byte stream: autopull every 8 bits. Byte writes to the FIFO are replicated to all lanes,
+        // so each byte lands in the MSBs the SM shifts out first, pixels need no word alignment.
+        bits = 8;
+    }
     #ifdef DEBUG
     printf("WS2812 / Initializing SM %u with offset %X at pin %u and %u data bits...\n", sm, offset, pin, bits);
     #endif
     ws2812_program_init(pio, sm, offset, pin, 800000, bits);
+
+    if (generator || storage == STORAGE_PACKED) {
+        dmaChannel = dma_claim_unused_channel(true);
+    }
+}
+
+void WS2812::setCaptureHook(CaptureHook hook, void *context) {
+    captureContext = context;
+    captureHook = hook;
+}
+
+void WS2812::capture(uint first, const uint8_t *wire, uint count) {
+    if (captureHook) {
+        captureHook(*this, first, wire, count, frameUs, captureContext);
+    }
+}
+
+// Word storage keeps the wire bytes in the MSBs, hand them over in small chunks
+void WS2812::capture(uint first, const uint32_t *words, uint count) {
+    if (!captureHook) {
+        return;
+    }
+    uint8_t wire[16 * 4];
+    while (count > 0) {
+        uint chunk = MIN(count, 16u);
+        for (uint i = 0; i < chunk; i++) {
+            for (uint b = 0; b < bytesPerPixel; b++) {
+                wire[i * bytesPerPixel + b] = (uint8_t)(words[i] >> (24 - 8 * b));
+            }
+        }
+        captureHook(*this, first, wire, chunk, frameUs, captureContext);
+        first += chunk;
+        words += chunk;
+        count -= chunk;
+    }
+}
+
+uint32_t WS2812::decodeWire(const uint8_t *wire) {
+    uint32_t rgbw = 0;
+    // A 24-bit format has NONE in the first slot and the first wire byte belongs to the second one
+    for (uint b = 4 - bytesPerPixel, i = 0; b < 4; b++, i++) {
+        switch (bytes[b]) {
+            case RED:
+                rgbw |= (uint32_t)wire[i];
+                break;
+            case GREEN:
+                rgbw |= (uint32_t)wire[i] << 8;
+                break;
+            case BLUE:
+                rgbw |= (uint32_t)wire[i] << 16;
+                break;
+            case WHITE:
+                rgbw |= (uint32_t)wire[i] << 24;
+                break;
+            default:
+                break;
+        }
+    }
+    return rgbw;
+}
+
+bool WS2812::canUsePio(PIO pio) {
+    return programOffset[pio_get_index(pio)] >= 0 || pio_can_add_program(pio, &ws2812_program);
 }
 
 uint32_t WS2812::convertData(uint32_t rgbw) {
     uint32_t result = 0;
     for (uint b = 0; b < 4; b++) {
+        result <<= 8;
         switch (bytes[b]) {
             case RED:
                 result |= (rgbw & 0xFF);
@@ -71,15 +187,33 @@ uint32_t WS2812::convertData(uint32_t rgbw) {
             case WHITE:
                 result |= (rgbw & 0xFF000000) >> 24;
                 break;
+            case NONE:
+                break;
         }
+    }
+    // 24 bit formats are sent from the MSBs too
+    if (bytesPerPixel == 3) {
         result <<= 8;
     }
     return result;
 }
 
+// Wire word keeps the bytes to send MSB first, packed storage keeps just those bytes
+void WS2812::storePixel(uint index, uint32_t wire) {
+    if (packed) {
+        uint8_t *pixel = &packed[index * bytesPerPixel];
+        for (uint b = 0; b < bytesPerPixel; b++) {
+            pixel[b] = (uint8_t)(wire >> (24 - 8 * b));
+        }
+    } else {
+        data[index] = wire;
+    }
+}
+
 void WS2812::setPixelColor(uint index, uint32_t color) {
-    if (index < length) {
-        data[index] = convertData(color);
+    if (index < length && (data || packed)) {
+        storePixel(index, convertData(color));
+        generation++;
     }
 }
 
@@ -104,19 +238,246 @@ void WS2812::fill(uint32_t color, uint first, uint count) {
     if (last > length) {
         last = length;
     }
+    if (!data && !packed) {
+        return;
+    }
     color = convertData(color);
     for (uint i = first; i < last; i++) {
-        data[i] = color;
+        storePixel(i, color);
     }
+    generation++;
+}
+
+// Stage a blank frame, it is pushed by the next show()
+void WS2812::clear() {
+    fill(0, 0, length);
+}
+
+void WS2812::setLut(const uint8_t *lut) {
+    if (lut && !scaled && (data || packed)) {
+        scaled = new uint32_t[packed ? (length * bytesPerPixel + 3) / 4 : length];
+    }
+    this->lut = lut;
+    // Same pixels, but another frame on the wire
+    shown = false;
+    shownFrame = nullptr;
+}
+
+// Copy of the frame with the table applied, valid until the next push
+const uint8_t *WS2812::scale(const uint8_t *frame, uint bytes) {
+    uint8_t *out = (uint8_t *)scaled;
+    memcpy(out, frame, bytes);
+    pixel_lut_apply(out, bytes, lut);
+    return out;
+}
+
+// FNV-1a over the pixel words (or bytes), cheap enough for rings of a few dozen LEDs
+uint32_t WS2812::hashData() {
+    uint32_t hash = 2166136261u;
+    if (packed) {
+        for (uint i = 0; i < length * bytesPerPixel; i++) {
+            hash = (hash ^ packed[i]) * 16777619u;
+        }
+    } else {
+        for (uint i = 0; i < length; i++) {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+    }
+    return hash;
 }
 
 void WS2812::show() {
+    if (beginShow()) {
+        endShow();
+    }
+}
+
+bool WS2812::beginShow() {
+    waitIdle();
+
+    if (generator) {
+        showStream();
+        pushes++;
+        endShow();
+        return false;
+    }
+
+    // Nothing written since the last push, or the writes produced the same frame again
+    if (shown && generation == shownGeneration) {
+        skips++;
+        return false;
+    }
+    uint32_t hash = hashData();
+    shownGeneration = generation;
+    if (shown && hash == shownHash) {
+        skips++;
+        return false;
+    }
+    shownHash = hash;
+    shown = true;
+    shownFrame = nullptr;
+    pushes++;
+    frameUs = time_us_64();
+
+    if (packed) {
+        const uint8_t *wire = (lut ? scale(packed, length * bytesPerPixel) : packed);
+        capture(0, wire, length);
+        startPacked(wire);
+        return true;
+    }
+
+    // 24 bit words keep 0 in the LSBs, the table maps 0 to 0
+    const uint32_t *words = (lut ? (const uint32_t *)scale((const uint8_t *)data, length * sizeof(uint32_t)) : data);
+    capture(0, words, length);
+
     #ifdef DEBUG
     for (uint i = 0; i < length; i++) {
-        printf("WS2812 / Put data: %08X\n", data[i]);
+        printf("WS2812 / Put data: %08X\n", words[i]);
     }
     #endif
     for (uint i = 0; i < length; i++) {
-        pio_sm_put_blocking(pio, sm, data[i]);
+        pio_sm_put_blocking(pio, sm, words[i]);
     }
-}
\ No newline at end of file
+    return true;
+}
+
+void WS2812::endShow() {
+    if (dmaChannel >= 0) {
+        dma_channel_wait_for_finish_blocking(dmaChannel);
+    }
+    while (!pio_sm_is_tx_fifo_empty(pio, sm)) {
+        tight_loop_contents();
+    }
+    // The OSR may still hold one word, then the line must stay low for the latch
+    idleAt = time_us_64() + WORD_US + LATCH_US;
+}
+
+void WS2812::waitIdle() {
+    while (time_us_64() < idleAt) {
+        tight_loop_contents();
+    }
+}
+
+void WS2812::showFrame(const uint8_t *frame) {
+    if (beginShowFrame(frame)) {
+        endShow();
+    }
+}
+
+bool WS2812::beginShowFrame(const uint8_t *frame) {
+    if (storage != STORAGE_PACKED) {
+        return false;
+    }
+    // Frames in flash are immutable, the same pointer means the same picture
+    if (frame == shownFrame) {
+        skips++;
+        return false;
+    }
+    waitIdle();
+    shownFrame = frame;
+    shown = false;  // The pixel buffer is no longer what the strip displays
+    pushes++;
+    frameUs = time_us_64();
+    if (lut) {
+        frame = scale(frame, length * bytesPerPixel);
+    }
+    capture(0, frame, length);
+    startPacked(frame);
+    return true;
+}
+
+void WS2812::startPacked(const uint8_t *frame) {
+    dma_channel_config c = dma_channel_get_default_config(dmaChannel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(dmaChannel, &c, &pio->txf[sm], frame, length * bytesPerPixel, true);
+}
+
+// Ring buffer shared by all streaming strips. show() is blocking, so only one strip streams at a time
+// (the LED code is serialized by the caller, see myLock). Aligned to its size for the DMA read ring wrap.
+static uint32_t streamRing[2 * WS2812::STREAM_CHUNK] __attribute__((aligned(2 * WS2812::STREAM_CHUNK * sizeof(uint32_t))));
+
+#define STREAM_RING_BITS 9 // log2(sizeof(streamRing))
+static_assert(sizeof(streamRing) == (1u << STREAM_RING_BITS), "Ring size must match the DMA wrap");
+
+void WS2812::showStream() {
+    if (length == 0) {
+        return;
+    }
+
+    // Prefill both halves before the DMA starts
+    frameUs = time_us_64();
+    uint produced = 0;
+    for (uint half = 0; half < 2 && produced < length; half++) {
+        uint count = MIN(STREAM_CHUNK, length - produced);
+        uint32_t *chunk = &streamRing[half * STREAM_CHUNK];
+        generator(produced, count, chunk, generatorContext);
+        for (uint i = 0; i < count; i++) {
+            chunk[i] = convertData(chunk[i]);
+        }
+        if (lut) {
+            pixel_lut_apply((uint8_t *)chunk, count * sizeof(uint32_t), lut);
+        }
+        capture(produced, chunk, count);
+        produced += count;
+    }
+
+    dma_channel_config c = dma_channel_get_default_config(dmaChannel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, STREAM_RING_BITS);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(dmaChannel, &c, &pio->txf[sm], streamRing, length, true);
+
+    // The SM was stalled waiting for the first word, the stall flag is only meaningful once the FIFO got filled
+    const uint32_t stallMask = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+    bool stallArmed = false;
+    bool underflow = false;
+
+    while (produced < length) {
+        // Wait until the DMA has drained the half we are going to overwrite
+        uint consumed;
+        do {
+            consumed = length - dma_hw->ch[dmaChannel].transfer_count;
+            if (!stallArmed && consumed >= 8) {
+                pio->fdebug = stallMask;
+                stallArmed = true;
+            }
+        } while (consumed + STREAM_CHUNK < produced);
+
+        uint count = MIN(STREAM_CHUNK, length - produced);
+        uint32_t *chunk = &streamRing[(produced / STREAM_CHUNK) % 2 * STREAM_CHUNK];
+        generator(produced, count, chunk, generatorContext);
+        for (uint i = 0; i < count; i++) {
+            chunk[i] = convertData(chunk[i]);
+        }
+        if (lut) {
+            pixel_lut_apply((uint8_t *)chunk, count * sizeof(uint32_t), lut);
+        }
+        capture(produced, chunk, count);
+
+        // DMA got into this half while the generator was still filling it
+        consumed = length - dma_hw->ch[dmaChannel].transfer_count;
+        if (consumed > produced) {
+            underflow = true;
+        }
+        produced += count;
+    }
+
+    // The stall flag is read before the transfer count, so a stall seen with words left is a real FIFO underrun
+    if (stallArmed && (pio->fdebug & stallMask) && dma_hw->ch[dmaChannel].transfer_count > 0) {
+        underflow = true;
+    }
+
+    dma_channel_wait_for_finish_blocking(dmaChannel);
+
+    if (underflow) {
+        underflows++;
+        #ifdef DEBUG
+        printf("WS2812 / Stream underflow on SM %u (%u so far)\n", sm, underflows);
+        #endif
+    }
+}
@@ -18,13 +18,27 @@ class WS2812 {
             FORMAT_GRB=1,
             FORMAT_WRGB=2
         };
+        enum Storage {
+            STORAGE_WORD=0,     // One 32-bit word per pixel, pushed word by word
+            STORAGE_PACKED=1    // 3 (or 4 for WRGB) bytes per pixel in wire order, pushed by a byte DMA
+        };
 
         WS2812(uint pin, uint length, PIO pio, uint sm);
         WS2812(uint pin, uint length, PIO pio, uint sm, DataFormat format);
+        WS2812(uint pin, uint length, PIO pio, uint sm, DataFormat format, Storage storage);
         WS2812(uint pin, uint length, PIO pio, uint sm, DataByte b1, DataByte b2, DataByte b3);
         WS2812(uint pin, uint length, PIO pio, uint sm, DataByte b1, DataByte b2, DataByte b3, DataByte b4);
         ~WS2812();
 
+        // Streaming mode: no frame buffer is allocated, show() pulls the pixels from the generator
+        // in chunks of STREAM_CHUNK into a small DMA ring buffer, so the strip length is not limited by RAM.
+        // The generator gets the index of the first pixel and fills count RGB(W) colors.
+        typedef void (*PixelGenerator)(uint first, uint count, uint32_t *colors, void *context);
+
+        static const uint STREAM_CHUNK = 64;    // Pixels per ring buffer half
+
+        WS2812(uint pin, uint length, PIO pio, uint sm, DataFormat format, PixelGenerator generator, void *context);
+
         static uint32_t RGB(uint8_t red, uint8_t green, uint8_t blue) {
             return (uint32_t)(blue) << 16 | (uint32_t)(green) << 8 | (uint32_t)(red);
         };
@@ -39,8 +53,55 @@ class WS2812 {
         void fill(uint32_t color);
         void fill(uint32_t color, uint first);
         void fill(uint32_t color, uint first, uint count);
+        void clear();
         void show();
 
+        // Per-channel table (brightness, gamma, see pixel_lut_build()) applied to every frame on its way out,
+        // the stored pixels keep their colors. The table is not copied, nullptr turns it off.
+        void setLut(const uint8_t *lut);
+
+        // show() split in two, used to start several strips together (see LedOutputs).
+        // beginShow() returns false when there was nothing to push.
+        bool beginShow();
+        bool beginShowFrame(const uint8_t *frame);
+        void endShow();
+        void waitIdle();
+
+        // True when the program is already loaded in the PIO block or there is space for it
+        static bool canUsePio(PIO pio);
+
+        bool isPacked() { return packed != nullptr; }
+        PIO getPio() { return pio; }
+        uint getSm() { return sm; }
+
+        // Push a packed frame (wire order, see STORAGE_PACKED) straight from flash or an SD read buffer.
+        // The strip must use packed storage.
+        void showFrame(const uint8_t *frame);
+
+        // Frame capture, e.g. for a host build against a mocked PIO or a debug dump. Called for every pushed
+        // frame (in chunks for word and streaming storage) with count pixels in wire order, getBytesPerPixel()
+        // bytes each, starting at pixel first. frameUs is the time the frame started.
+        typedef void (*CaptureHook)(WS2812 &strip, uint first, const uint8_t *wire, uint count, uint64_t frameUs, void *context);
+
+        static void setCaptureHook(CaptureHook hook, void *context);
+
+        // Wire order bytes of one pixel back to RGB(W), inverse of the color order conversion
+        uint32_t decodeWire(const uint8_t *wire);
+
+        uint getLength() { return length; }
+        uint getBytesPerPixel() { return bytesPerPixel; }
+
+        // Cost model: 1.25 us per bit at 800 kHz plus the latch time
+        uint getWireTimeUs() { return (length * bytesPerPixel * 8 * 5 + 3) / 4 + LATCH_US; }
+        uint64_t getTotalWireTimeUs() { return (uint64_t)pushes * getWireTimeUs(); }
+
+        // show() only pushes the frame when the pixel buffer differs from the last pushed one
+        uint getShowCount() { return pushes; }
+        uint getSkippedShowCount() { return skips; }
+
+        // Number of times the generator did not keep up with the DMA / PIO in streaming mode
+        uint getUnderflowCount() { return underflows; }
+
         void initialize(uint pin, uint length, PIO pio, uint sm, DataByte b1, DataByte b2, DataByte b3, DataByte b4);
 
     private:
@@ -50,9 +111,45 @@ class WS2812 {
         uint sm;
         DataByte bytes[4];
         uint32_t *data;
+        Storage storage = STORAGE_WORD;
+        uint8_t *packed = nullptr;
+        uint bytesPerPixel;
+
+        const uint8_t *lut = nullptr;
+        uint32_t *scaled = nullptr;     // Frame after the table, what the DMA or the FIFO gets
+
+        PixelGenerator generator = nullptr;
+        void *generatorContext = nullptr;
+        int dmaChannel = -1;
+        uint underflows = 0;
+
+        uint32_t generation = 0;        // Bumped by every write into the pixel buffer
+        uint32_t shownGeneration = 0;   // Generation of the last pushed frame
+        uint32_t shownHash = 0;         // Hash of the last pushed frame
+        const uint8_t *shownFrame = nullptr;  // Last frame pushed by showFrame()
+        bool shown = false;
+        uint pushes = 0;
+        uint skips = 0;
+
+        static const uint WORD_US = 40;     // 32 bits at 800 kHz
+        static const uint LATCH_US = 50;    // Low time that latches the frame
+        uint64_t idleAt = 0;                // Time when the strip is ready for the next frame
+
+        static int programOffset[2];        // Offset of the loaded program per PIO block, -1 if not loaded
+
+        static CaptureHook captureHook;
+        static void *captureContext;
+        uint64_t frameUs = 0;               // Start of the frame being pushed, for the capture hook
 
-        
+        void initialize(uint pin, uint length, PIO pio, uint sm, DataFormat format);
         uint32_t convertData(uint32_t rgbw);
+        uint32_t hashData();
+        const uint8_t *scale(const uint8_t *frame, uint bytes);
+        void storePixel(uint index, uint32_t wire);
+        void startPacked(const uint8_t *frame);
+        void capture(uint first, const uint8_t *wire, uint count);
+        void capture(uint first, const uint32_t *words, uint count);
+        void showStream();
 
 };
 
@@ -0,0 +1,103 @@
+/* civil_time.c
+ *
+ * Day <-> date conversion after Howard Hinnant's days_from_civil / civil_from_days: the year is
+ * shifted to start in March, so the leap day is the last day of the year and month lengths follow
+ * the (153 * m + 2) / 5 pattern. Only integer division by constants, no tables, no loops.
+ */
+#include "civil_time.h"
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+int64_t civil_days_from_date(int64_t year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = (unsigned)(year - era * 400);                              // 0..399
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; // 0..365
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                     // 0..146096
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+void civil_date_from_days(int64_t days, int32_t *year, unsigned *month, unsigned *day)
+{
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = (unsigned)(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = m;
+    *year = (int32_t)((int64_t)yoe + era * 400 + (m <= 2));
+}
+
+unsigned civil_weekday(int64_t days)
+{
+    // 1970-01-01 was Thursday
+    return (unsigned)(days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6);
+}
+
+bool civil_is_leap(int64_t year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+unsigned civil_days_in_month(int64_t year, unsigned month)
+{
+    // 31 days in odd months up to July and in even months from August
+    if (month == 2)
+    {
+        return civil_is_leap(year) ? 29 : 28;
+    }
+    return 30 + ((month + (month >> 3)) & 1);
+}
+
+// ISO years have 53 weeks when they start on Thursday, or on Wednesday in a leap year
+static unsigned iso_weeks(int32_t year)
+{
+    unsigned jan1 = civil_weekday(civil_days_from_date(year, 1, 1));
+    return (jan1 == 4 || (jan1 == 3 && civil_is_leap(year))) ? 53 : 52;
+}
+
+void civil_from_unix(int64_t seconds, civil_time_t *t)
+{
+    int64_t days = floor_div(seconds, CIVIL_SECONDS_PER_DAY);
+    uint32_t sod = (uint32_t)(seconds - days * CIVIL_SECONDS_PER_DAY);
+    unsigned month, day;
+
+    civil_date_from_days(days, &t->year, &month, &day);
+    t->month = month;
+    t->day = day;
+    t->hour = sod / 3600;
+    t->minute = sod / 60 % 60;
+    t->second = sod % 60;
+    t->weekday = civil_weekday(days);
+    t->yday = (uint16_t)(days - civil_days_from_date(t->year, 1, 1));
+
+    // Week with the year's first Thursday is week 1, weeks start on Monday
+    unsigned isoWeekday = t->weekday ? t->weekday : 7;
+    int week = (t->yday + 1 - (int)isoWeekday + 10) / 7;
+    t->iso_year = t->year;
+    if (week < 1)
+    {
+        t->iso_year--;
+        week = iso_weeks(t->iso_year);
+    }
+    else if (week == 53 && iso_weeks(t->year) == 52)
+    {
+        t->iso_year++;
+        week = 1;
+    }
+    t->iso_week = week;
+}
+
+int64_t civil_to_unix(const civil_time_t *t)
+{
+    return civil_days_from_date(t->year, t->month, t->day) * CIVIL_SECONDS_PER_DAY
+         + t->hour * 3600 + t->minute * 60 + t->second;
+}
@@ -0,0 +1,48 @@
+/* civil_time.h
+ *
+ * Calendar conversion of 64-bit Unix seconds, proleptic Gregorian calendar, UTC.
+ *
+ * Replaces gmtime(): results go to a caller owned struct, nothing is static and nothing is allocated,
+ * so the functions can be called from both cores and from interrupt handlers.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CIVIL_SECONDS_PER_DAY 86400
+
+typedef struct {
+    int32_t year;
+    uint8_t month;      // 1..12
+    uint8_t day;        // 1..31
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t weekday;    // 0 = Sunday .. 6 = Saturday, same as tm_wday
+    uint16_t yday;      // 0..365, same as tm_yday
+    uint8_t iso_week;   // ISO 8601 week 1..53
+    int32_t iso_year;   // Year the ISO week belongs to, differs from year around new year
+} civil_time_t;
+
+// Days since 1970-01-01 of a date, and back
+int64_t civil_days_from_date(int64_t year, unsigned month, unsigned day);
+void civil_date_from_days(int64_t days, int32_t *year, unsigned *month, unsigned *day);
+
+// 0 = Sunday
+unsigned civil_weekday(int64_t days);
+
+bool civil_is_leap(int64_t year);
+unsigned civil_days_in_month(int64_t year, unsigned month);
+
+// Full breakdown of Unix seconds, and back (weekday and week fields are ignored)
+void civil_from_unix(int64_t seconds, civil_time_t *t);
+int64_t civil_to_unix(const civil_time_t *t);
+
+#ifdef __cplusplus
+}
+#endif
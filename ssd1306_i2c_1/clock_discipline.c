@@ -0,0 +1,263 @@
+/* clock_discipline.c
+ *
+ * The time constant of the loop is CLOCK_DISCIPLINE_TC poll intervals. Within it the phase slew
+ * corrects the offset, the PLL integrates offset * interval / (4 * T^2) into the frequency, which
+ * makes the loop critically damped. At long polls the offset change over an interval measures the
+ * frequency directly, the FLL adds a quarter of that.
+ *
+ * The slew is applied in steps (every holdover sample and NTP update), each one removes what the
+ * previous rate corrected and picks phase / T again, so the phase decays exponentially and the
+ * slew ends by itself when NTP goes silent.
+ */
+#include <math.h>
+
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "timekeeping.h"
+#include "clock_discipline.h"
+
+#define CLOCK_DISCIPLINE_TC 4           // Time constant in poll intervals
+#define CLOCK_DISCIPLINE_FLL_POLL 8     // FLL from 256 s on
+#define CLOCK_DISCIPLINE_PGATE 4        // Offsets within PGATE * jitter count as stable
+#define CLOCK_DISCIPLINE_LIMIT 30       // Poll hysteresis
+#define CLOCK_DISCIPLINE_MIN_JITTER 100 // µs, the timer resolution and interrupt latency
+
+//----------------------------------------------------------------------------------------
+// Loop
+
+void clock_discipline_init(clock_discipline_t *d)
+{
+    d->phase_us = 0;
+    d->freq_ppb = 0;
+    d->slew_ppb = 0;
+    d->jitter_us = CLOCK_DISCIPLINE_MIN_JITTER;
+    d->wander_ppb = CLOCK_DISCIPLINE_MAX_FREQ_PPB;
+    d->last_offset_us = 0;
+    d->poll = CLOCK_DISCIPLINE_MIN_POLL;
+    d->poll_count = 0;
+    d->updates = 0;
+}
+
+static float clamp(float v, float limit)
+{
+    return v > limit ? limit : (v < -limit ? -limit : v);
+}
+
+static uint32_t time_constant_s(const clock_discipline_t *d)
+{
+    return CLOCK_DISCIPLINE_TC << d->poll;
+}
+
+static bool too_large(int64_t offsetUs)
+{
+    return offsetUs > CLOCK_DISCIPLINE_STEP_US || offsetUs < -CLOCK_DISCIPLINE_STEP_US;
+}
+
+// Stepped: nothing left to slew, the frequency stays
+static void stepped(clock_discipline_t *d)
+{
+    d->phase_us = 0;
+    d->slew_ppb = 0;
+    d->last_offset_us = 0;
+    d->poll = CLOCK_DISCIPLINE_MIN_POLL;
+    d->poll_count = 0;
+}
+
+bool clock_discipline_update(clock_discipline_t *d, int64_t offsetUs, uint32_t intervalS)
+{
+    if (too_large(offsetUs))
+    {
+        stepped(d);
+        return false;
+    }
+
+    if (d->updates && intervalS)
+    {
+        float t = (float)time_constant_s(d);
+
+        // PLL: µs * s / s^2 = ppm
+        float pll = (float)offsetUs * intervalS / (4 * t * t) * 1000;
+
+        // FLL: what grew since the previous update, beyond the phase still being slewed out
+        float fll = 0;
+        if (d->poll >= CLOCK_DISCIPLINE_FLL_POLL)
+        {
+            fll = (float)(offsetUs - d->phase_us) / intervalS * 1000 / 4;
+        }
+        float freq = clamp(d->freq_ppb + pll + fll, CLOCK_DISCIPLINE_MAX_FREQ_PPB);
+        float change = freq - d->freq_ppb;
+        d->wander_ppb = sqrtf(d->wander_ppb * d->wander_ppb + (change * change - d->wander_ppb * d->wander_ppb) / 4);
+        d->freq_ppb = freq;
+
+        // Jitter, exponential average of the squared offset differences
+        float diff = (float)(offsetUs - d->last_offset_us);
+        d->jitter_us = sqrtf(d->jitter_us * d->jitter_us + (diff * diff - d->jitter_us * d->jitter_us) / 4);
+        if (d->jitter_us < CLOCK_DISCIPLINE_MIN_JITTER)
+        {
+            d->jitter_us = CLOCK_DISCIPLINE_MIN_JITTER;
+        }
+
+        // Poll interval, RFC 5905 A.5.5.6
+        if (fabsf((float)offsetUs) < CLOCK_DISCIPLINE_PGATE * d->jitter_us)
+        {
+            d->poll_count += d->poll;
+            if (d->poll_count > CLOCK_DISCIPLINE_LIMIT)
+            {
+                d->poll_count = CLOCK_DISCIPLINE_LIMIT;
+                if (d->poll < CLOCK_DISCIPLINE_MAX_POLL)
+                {
+                    d->poll_count = 0;
+                    d->poll++;
+                }
+            }
+        }
+        else
+        {
+            d->poll_count -= 2 * d->poll;
+            if (d->poll_count < -CLOCK_DISCIPLINE_LIMIT)
+            {
+                d->poll_count = -CLOCK_DISCIPLINE_LIMIT;
+                if (d->poll > CLOCK_DISCIPLINE_MIN_POLL)
+                {
+                    d->poll_count = 0;
+                    d->poll--;
+                }
+            }
+        }
+    }
+
+    d->phase_us = offsetUs;
+    d->last_offset_us = offsetUs;
+    d->updates++;
+    clock_discipline_advance(d, 0);
+    return true;
+}
+
+void clock_discipline_advance(clock_discipline_t *d, uint64_t dtUs)
+{
+    // Part of the phase the previous slew took care of
+    int64_t corrected = (int64_t)dtUs * d->slew_ppb / 1000000000;
+    if ((d->phase_us > 0 && corrected > d->phase_us) || (d->phase_us < 0 && corrected < d->phase_us))
+    {
+        corrected = d->phase_us;
+    }
+    d->phase_us -= corrected;
+
+    // µs / s = ppm
+    float slew = (float)d->phase_us / (float)time_constant_s(d) * 1000;
+    d->slew_ppb = (int32_t)clamp(slew, CLOCK_DISCIPLINE_MAX_SLEW_PPB);
+}
+
+int32_t clock_discipline_rate_ppb(const clock_discipline_t *d)
+{
+    return (int32_t)d->freq_ppb + d->slew_ppb;
+}
+
+//----------------------------------------------------------------------------------------
+// Service
+
+static clock_discipline_t discipline = {
+    0, 0, 0, CLOCK_DISCIPLINE_MIN_JITTER, CLOCK_DISCIPLINE_MAX_FREQ_PPB, 0, CLOCK_DISCIPLINE_MIN_POLL, 0, 0
+};
+static int32_t basePpb;
+static uint64_t lastAdvance;
+static uint64_t lastUpdate;
+static int64_t correctedUs;
+
+// Interrupts are off while the counter and the slew change, the NTP receive callback reads them
+static void advance(uint64_t now)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    int64_t phase = discipline.phase_us;
+    clock_discipline_advance(&discipline, lastAdvance ? now - lastAdvance : 0);
+    correctedUs += phase - discipline.phase_us;
+    lastAdvance = now;
+    restore_interrupts(irq);
+}
+
+static void apply(uint64_t now)
+{
+    advance(now);
+    timekeeping_set_rate(basePpb + clock_discipline_rate_ppb(&discipline));
+}
+
+void clock_discipline_set_base(int32_t ppb)
+{
+    basePpb = ppb;
+    apply(time_us_64());
+}
+
+int32_t clock_discipline_get_base(void)
+{
+    return basePpb;
+}
+
+bool clock_discipline_offset(int64_t offsetUs, uint64_t timerUs)
+{
+    // The slew since the last advance is already in the offset
+    advance(timerUs);
+
+    // The loop is left alone until the caller really steps the clock, it may not be allowed to
+    if (too_large(offsetUs))
+    {
+        timekeeping_set_rate(basePpb + clock_discipline_rate_ppb(&discipline));
+        return false;
+    }
+
+    uint32_t interval = lastUpdate ? (uint32_t)((timerUs - lastUpdate) / 1000000) : 0;
+    uint32_t irq = save_and_disable_interrupts();
+    bool slewed = clock_discipline_update(&discipline, offsetUs, interval);
+    restore_interrupts(irq);
+    lastUpdate = slewed ? timerUs : 0;
+
+    timekeeping_set_rate(basePpb + clock_discipline_rate_ppb(&discipline));
+    return slewed;
+}
+
+void clock_discipline_step(int64_t offsetUs)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    correctedUs += offsetUs;
+    stepped(&discipline);
+    restore_interrupts(irq);
+    lastUpdate = 0;
+    timekeeping_set_rate(basePpb + clock_discipline_rate_ppb(&discipline));
+}
+
+uint32_t clock_discipline_poll_s(void)
+{
+    return 1u << discipline.poll;
+}
+
+int64_t clock_discipline_correction_us(uint64_t timerUs)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    int64_t corrected = correctedUs;
+    if (lastAdvance && timerUs > lastAdvance)
+    {
+        // Slewed since the last advance, at most what was left
+        int64_t phase = discipline.phase_us;
+        int64_t slewed = (int64_t)(timerUs - lastAdvance) * discipline.slew_ppb / 1000000000;
+        if ((phase > 0 && slewed > phase) || (phase < 0 && slewed < phase))
+        {
+            slewed = phase;
+        }
+        corrected += slewed;
+    }
+    restore_interrupts(irq);
+    return corrected;
+}
+
+const clock_discipline_t *clock_discipline_state(void)
+{
+    return &discipline;
+}
+
+void clock_discipline_restore(const clock_discipline_t *d)
+{
+    discipline = *d;
+    discipline.phase_us = 0;
+    discipline.slew_ppb = 0;
+    discipline.updates = 0;
+    lastUpdate = 0;
+}
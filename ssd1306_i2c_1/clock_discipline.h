@@ -0,0 +1,78 @@
+/* clock_discipline.h
+ *
+ * NTP clock discipline: offsets measured by the NTP client are slewed out by adjusting the clock
+ * rate instead of stepping the clock, and a frequency correction is learned so that the offsets
+ * stay small (a PLL, helped by an FLL at long poll intervals, after RFC 5905).
+ *
+ * The poll interval adapts between 64 s and 1024 s: while the offsets stay within a few times the
+ * measured jitter the clock is stable and NTP is asked less often, larger offsets bring it down.
+ *
+ * The rate given to timekeeping is the sum of the holdover prediction (temperature, holdover.c),
+ * the learned frequency and the phase slew, so the loop only has to track what the model misses.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLOCK_DISCIPLINE_MIN_POLL 6             // log2 s, 64 s
+#define CLOCK_DISCIPLINE_MAX_POLL 10            // 1024 s
+#define CLOCK_DISCIPLINE_STEP_US 128000         // Larger offsets are stepped
+#define CLOCK_DISCIPLINE_MAX_SLEW_PPB 500000    // 500 µs/s, like adjtime()
+#define CLOCK_DISCIPLINE_MAX_FREQ_PPB 500000
+
+typedef struct {
+    int64_t phase_us;       // Offset not slewed out yet
+    float freq_ppb;         // Learned frequency correction
+    int32_t slew_ppb;       // Rate correcting phase_us, applied since the last advance
+    float jitter_us;        // RMS of the offset differences
+    float wander_ppb;       // RMS of the frequency changes, how well the frequency is known
+    int64_t last_offset_us;
+    int8_t poll;            // log2 s
+    int16_t poll_count;     // Hysteresis of the poll interval
+    uint32_t updates;
+} clock_discipline_t;
+
+// The loop alone, without hardware
+void clock_discipline_init(clock_discipline_t *d);
+
+// New offset (true - local) intervalS seconds after the previous one (0 for the first one).
+// Returns false when the offset is too large to slew, the caller steps the clock then.
+bool clock_discipline_update(clock_discipline_t *d, int64_t offsetUs, uint32_t intervalS);
+
+// dtUs passed with the current slew: reduces the phase and picks the slew for the next span
+void clock_discipline_advance(clock_discipline_t *d, uint64_t dtUs);
+
+// Correction of the clock rate, positive makes the clock run faster
+int32_t clock_discipline_rate_ppb(const clock_discipline_t *d);
+
+// Base rate of the clock, e.g. the temperature prediction. Applies the sum to timekeeping.
+void clock_discipline_set_base(int32_t ppb);
+int32_t clock_discipline_get_base(void);
+
+// An NTP offset measured at timerUs. False: the clock has to be stepped instead, the loop is not
+// changed then, a sample that turns out not good enough to step the clock leaves the slew running.
+bool clock_discipline_offset(int64_t offsetUs, uint64_t timerUs);
+
+// The clock was stepped by offsetUs, nothing is left to slew and the poll interval starts again
+void clock_discipline_step(int64_t offsetUs);
+
+// Current poll interval in s
+uint32_t clock_discipline_poll_s(void);
+
+// Sum of all corrections of the clock phase (slews and steps) up to timerUs. The NTP filter
+// subtracts the part since a sample from its offset, so old samples do not correct twice.
+// May be called from interrupt handlers.
+int64_t clock_discipline_correction_us(uint64_t timerUs);
+
+// Loop state, e.g. to keep it over a reset
+const clock_discipline_t *clock_discipline_state(void);
+void clock_discipline_restore(const clock_discipline_t *d);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,388 @@
+/* dns_cache.c
+ *
+ * Minimal stub resolver: one A question per query, recursion desired, answers parsed with name
+ * compression. CNAME records in the answer are skipped, the server includes the A records of the
+ * target. A one second lwIP timer retransmits queries and starts the refreshes.
+ *
+ * Answers set the addresses of the NTP servers, so a forged one must be hard to get accepted:
+ * random query IDs and source port, only answers from the configured server and with our
+ * question echoed are taken.
+ */
+#include <string.h>
+#include <ctype.h>
+
+#include "lwip/dns.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/timeouts.h"
+#include "pico/time.h"
+
+#include "dns_cache.h"
+
+#define DNS_PORT 53
+#define DNS_HEADER_LEN 12
+#define DNS_MAX_PACKET 512
+#define DNS_TYPE_A 1
+#define DNS_CLASS_IN 1
+#define DNS_FLAG_RD 0x0100
+#define DNS_FLAG_QR 0x8000
+
+#define DNS_CACHE_WAITERS 4
+#define DNS_CACHE_RETRY_MS 2000
+#define DNS_CACHE_TRIES 3
+#define DNS_PORT_RANGE_START 0xc000     // Dynamic ports, RFC 6335
+
+typedef struct {
+    dns_cache_callback_t callback;
+    void *arg;
+} waiter_t;
+
+typedef struct {
+    char name[DNS_CACHE_NAME_LEN];
+    ip_addr_t addresses[DNS_CACHE_ADDRESSES];
+    uint8_t count;              // 0 until the first answer
+    uint8_t next;               // Rotation
+    bool used;                  // Looked up since the last refresh, refresh it before it expires
+    uint64_t expires_us;
+    uint64_t refresh_us;        // 7/8 of the TTL
+
+    // Query in flight
+    bool querying;
+    uint16_t id;
+    uint8_t tries;
+    uint64_t retry_us;
+    waiter_t waiters[DNS_CACHE_WAITERS];
+} entry_t;
+
+static entry_t entries[DNS_CACHE_ENTRIES];
+static struct udp_pcb *pcb;
+static uint8_t packet[DNS_MAX_PACKET];
+
+//----------------------------------------------------------------------------------------
+// Queries
+
+static void send_query(entry_t *e)
+{
+    const ip_addr_t *server = dns_getserver(0);
+    if (!server || ip_addr_isany(server))
+        return;
+
+    // Header, name as length prefixed labels, type, class
+    size_t nameLen = strlen(e->name);
+    u16_t len = (u16_t)(DNS_HEADER_LEN + nameLen + 2 + 4);
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (!p)
+        return;
+
+    uint8_t *q = (uint8_t *)p->payload;
+    memset(q, 0, DNS_HEADER_LEN);
+    q[0] = e->id >> 8;
+    q[1] = e->id;
+    q[2] = DNS_FLAG_RD >> 8;
+    q[5] = 1;   // QDCOUNT
+
+    uint8_t *label = q + DNS_HEADER_LEN;
+    uint8_t *out = label + 1;
+    for (const char *c = e->name; ; c++)
+    {
+        if (*c == '.' || *c == 0)
+        {
+            *label = (uint8_t)(out - label - 1);
+            label = out++;
+            if (*c == 0)
+                break;
+        }
+        else
+        {
+            *out++ = (uint8_t)*c;
+        }
+    }
+    *label = 0;
+    out[0] = 0;
+    out[1] = DNS_TYPE_A;
+    out[2] = 0;
+    out[3] = DNS_CLASS_IN;
+
+    udp_sendto(pcb, p, server, DNS_PORT);
+    pbuf_free(p);
+}
+
+static void start_query(entry_t *e)
+{
+    e->querying = true;
+    e->id = (uint16_t)LWIP_RAND();
+    e->tries = 1;
+    e->retry_us = time_us_64() + DNS_CACHE_RETRY_MS * 1000ull;
+    send_query(e);
+}
+
+static void notify(entry_t *e, const ip_addr_t *address)
+{
+    for (uint32_t i = 0; i < DNS_CACHE_WAITERS; i++)
+    {
+        waiter_t w = e->waiters[i];
+        e->waiters[i].callback = NULL;
+        if (w.callback)
+        {
+            w.callback(e->name, address, w.arg);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------------
+// Answers
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+// Offset after a possibly compressed name, 0 when it runs past the end
+static uint32_t skip_name(const uint8_t *p, uint32_t len, uint32_t offset)
+{
+    while (offset < len)
+    {
+        uint8_t l = p[offset];
+        if (l == 0)
+            return offset + 1;
+        if ((l & 0xc0) == 0xc0)
+            return offset + 2 <= len ? offset + 2 : 0;
+        offset += l + 1;
+    }
+    return 0;
+}
+
+// The single question at offset is name with type A, class IN. Returns the offset after it, 0 if not.
+static uint32_t match_question(const uint8_t *p, uint32_t len, uint32_t offset, const char *name)
+{
+    const char *c = name;
+    while (offset < len)
+    {
+        uint8_t l = p[offset++];
+        if (l == 0)
+            break;
+        // Compression never appears in the echoed question
+        if ((l & 0xc0) || offset + l > len)
+            return 0;
+        if (c != name && *c++ != '.')
+            return 0;
+        for (uint32_t i = 0; i < l; i++, c++)
+        {
+            // Servers may echo the case differently
+            if (!*c || tolower(p[offset + i]) != tolower((unsigned char)*c))
+                return 0;
+        }
+        offset += l;
+    }
+    if (*c || offset + 4 > len || get16(p + offset) != DNS_TYPE_A || get16(p + offset + 2) != DNS_CLASS_IN)
+        return 0;
+    return offset + 4;
+}
+
+static void dns_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    (void)arg;
+    (void)upcb;
+    uint32_t len = pbuf_copy_partial(p, packet, sizeof(packet), 0);
+    pbuf_free(p);
+    const ip_addr_t *server = dns_getserver(0);
+    if (port != DNS_PORT || len < DNS_HEADER_LEN || !server || !ip_addr_cmp(addr, server))
+        return;
+
+    uint16_t id = get16(packet);
+    uint16_t flags = get16(packet + 2);
+    entry_t *e = NULL;
+    for (uint32_t i = 0; i < DNS_CACHE_ENTRIES; i++)
+    {
+        if (entries[i].querying && entries[i].id == id)
+        {
+            e = &entries[i];
+        }
+    }
+    if (!e || !(flags & DNS_FLAG_QR) || get16(packet + 4) != 1)
+        return;
+
+    // An answer to another question with a guessed ID, the query stays open
+    uint32_t offset = match_question(packet, len, DNS_HEADER_LEN, e->name);
+    if (!offset)
+        return;
+    e->querying = false;
+
+    uint32_t answers = get16(packet + 6);
+
+    ip_addr_t found[DNS_CACHE_ADDRESSES];
+    uint32_t count = 0;
+    uint32_t ttl = DNS_CACHE_MAX_TTL;
+    for (uint32_t i = 0; i < answers && offset; i++)
+    {
+        offset = skip_name(packet, len, offset);
+        if (!offset || offset + 10 > len)
+            break;
+        uint16_t type = get16(packet + offset);
+        uint16_t cls = get16(packet + offset + 2);
+        uint32_t recordTtl = (uint32_t)get16(packet + offset + 4) << 16 | get16(packet + offset + 6);
+        uint16_t dataLen = get16(packet + offset + 8);
+        offset += 10;
+        if (offset + dataLen > len)
+            break;
+
+        if (type == DNS_TYPE_A && cls == DNS_CLASS_IN && dataLen == 4 && count < DNS_CACHE_ADDRESSES)
+        {
+            const uint8_t *a = packet + offset;
+            IP_ADDR4(&found[count], a[0], a[1], a[2], a[3]);
+            count++;
+            ttl = recordTtl < ttl ? recordTtl : ttl;
+        }
+        offset += dataLen;
+    }
+
+    if ((flags & 0xf) != 0 || !count)
+    {
+        // Failed: keep serving what we had, waiters of a first lookup learn the bad news.
+        // No printing here, this may be an interrupt (background cyw43 arch).
+        if (!e->count)
+        {
+            notify(e, NULL);
+        }
+        return;
+    }
+
+    if (ttl < DNS_CACHE_MIN_TTL)
+    {
+        ttl = DNS_CACHE_MIN_TTL;
+    }
+    uint64_t now = time_us_64();
+    memcpy(e->addresses, found, count * sizeof(found[0]));
+    e->count = (uint8_t)count;
+    e->next = 0;
+    e->used = false;
+    e->expires_us = now + ttl * 1000000ull;
+    e->refresh_us = now + ttl * 875000ull;
+    notify(e, &e->addresses[e->next++ % e->count]);
+}
+
+//----------------------------------------------------------------------------------------
+// Timer: retransmits and refreshes
+
+static void dns_cache_timer(void *arg)
+{
+    (void)arg;
+    uint64_t now = time_us_64();
+
+    for (uint32_t i = 0; i < DNS_CACHE_ENTRIES; i++)
+    {
+        entry_t *e = &entries[i];
+        if (!e->name[0])
+            continue;
+
+        if (e->querying && now >= e->retry_us)
+        {
+            if (e->tries >= DNS_CACHE_TRIES)
+            {
+                e->querying = false;
+                if (!e->count)
+                {
+                    notify(e, NULL);
+                }
+            }
+            else
+            {
+                e->tries++;
+                e->retry_us = now + DNS_CACHE_RETRY_MS * 1000ull;
+                send_query(e);
+            }
+        }
+        else if (!e->querying && e->count && e->used && now >= e->refresh_us)
+        {
+            start_query(e);
+        }
+    }
+
+    sys_timeout(1000, dns_cache_timer, NULL);
+}
+
+bool dns_cache_init(void)
+{
+    pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb)
+        return false;
+    // A random source port, answers have to guess it as well as the ID
+    if (udp_bind(pcb, IP_ANY_TYPE, (u16_t)(DNS_PORT_RANGE_START + LWIP_RAND() % 0x4000)) != ERR_OK)
+    {
+        udp_bind(pcb, IP_ANY_TYPE, 0);
+    }
+    udp_recv(pcb, dns_recv, NULL);
+    sys_timeout(1000, dns_cache_timer, NULL);
+    return true;
+}
+
+//----------------------------------------------------------------------------------------
+// Lookup
+
+static entry_t *find_entry(const char *hostname)
+{
+    entry_t *freeEntry = NULL;
+    entry_t *oldest = NULL;
+    for (uint32_t i = 0; i < DNS_CACHE_ENTRIES; i++)
+    {
+        entry_t *e = &entries[i];
+        if (!strcmp(e->name, hostname))
+            return e;
+        if (!e->name[0] && !freeEntry)
+        {
+            freeEntry = e;
+        }
+        if (!e->querying && (!oldest || e->expires_us < oldest->expires_us))
+        {
+            oldest = e;
+        }
+    }
+
+    // New name, replaces the entry that expires first
+    entry_t *e = freeEntry ? freeEntry : oldest;
+    if (e)
+    {
+        memset(e, 0, sizeof(*e));
+        strcpy(e->name, hostname);
+    }
+    return e;
+}
+
+err_t dns_cache_resolve(const char *hostname, ip_addr_t *address, dns_cache_callback_t callback, void *arg)
+{
+    if (ipaddr_aton(hostname, address))
+        return ERR_OK;
+    if (!pcb || strlen(hostname) >= DNS_CACHE_NAME_LEN)
+        return ERR_ARG;
+
+    entry_t *e = find_entry(hostname);
+    if (!e)
+        return ERR_MEM;
+    e->used = true;
+
+    if (e->count)
+    {
+        // Stale entries are served while the refresh runs
+        if (!e->querying && time_us_64() >= e->expires_us)
+        {
+            start_query(e);
+        }
+        *address = e->addresses[e->next++ % e->count];
+        return ERR_OK;
+    }
+
+    for (uint32_t i = 0; i < DNS_CACHE_WAITERS; i++)
+    {
+        if (!e->waiters[i].callback)
+        {
+            e->waiters[i].callback = callback;
+            e->waiters[i].arg = arg;
+            if (!e->querying)
+            {
+                start_query(e);
+            }
+            return ERR_INPROGRESS;
+        }
+    }
+    return ERR_MEM;
+}
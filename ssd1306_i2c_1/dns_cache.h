@@ -0,0 +1,41 @@
+/* dns_cache.h
+ *
+ * Resolver cache for the outbound services (NTP), on top of the lwIP raw API.
+ *
+ * lwIP's dns_gethostbyname() reports one address and no TTL, so the cache sends its own A queries
+ * to the DNS server from DHCP. Answers are kept with their TTL and refreshed in the background
+ * shortly before they expire, as long as somebody used them. An expired entry is still served
+ * while its refresh is under way. Names with several A records hand them out in turn.
+ *
+ * All functions run in lwIP context (callbacks or between cyw43_arch_lwip_begin() / _end()).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lwip/ip_addr.h"
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_CACHE_ENTRIES 8
+#define DNS_CACHE_ADDRESSES 4       // A records kept per name
+#define DNS_CACHE_NAME_LEN 64
+#define DNS_CACHE_MIN_TTL 60        // s, pool.ntp.org answers with ~150 s
+#define DNS_CACHE_MAX_TTL 86400
+
+typedef void (*dns_cache_callback_t)(const char *hostname, const ip_addr_t *address, void *arg);
+
+// Creates the pcb and starts the refresh timer
+bool dns_cache_init(void);
+
+// Same contract as dns_gethostbyname(): ERR_OK with the address when it is cached (or an address
+// literal), ERR_INPROGRESS when callback will be called with the answer (NULL on failure).
+err_t dns_cache_resolve(const char *hostname, ip_addr_t *address, dns_cache_callback_t callback, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,152 @@
+/* drift_file.c
+ *
+ * Interrupts are off while the page is written, no handler may run from flash while it can not
+ * be read. Core 1 is not used, so nothing else needs to be stopped. The stored frequency is the total
+ * correction (temperature base + loop), the base is subtracted again when it is restored.
+ */
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "pico/time.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "clock_discipline.h"
+#include "drift_file.h"
+
+#define DRIFT_FILE_MAGIC 0x44524654     // "DRFT"
+#define DRIFT_FILE_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define DRIFT_FILE_PAGES (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    int32_t freq_ppb;       // Total frequency correction
+    uint32_t wander_ppb;    // Confidence: RMS of the frequency changes when it was saved
+    uint32_t checksum;
+} record_t;
+
+static const record_t *page(uint32_t index)
+{
+    return (const record_t *)(XIP_BASE + DRIFT_FILE_OFFSET + index * FLASH_PAGE_SIZE);
+}
+
+// FNV-1a, as used for the LED frames
+static uint32_t checksum(const record_t *r)
+{
+    const uint8_t *p = (const uint8_t *)r;
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < offsetof(record_t, checksum); i++)
+    {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool valid(const record_t *r)
+{
+    return r->magic == DRIFT_FILE_MAGIC && r->checksum == checksum(r);
+}
+
+// Page of the newest record, -1 when there is none
+static int32_t newest(void)
+{
+    int32_t best = -1;
+    for (uint32_t i = 0; i < DRIFT_FILE_PAGES; i++)
+    {
+        if (valid(page(i)) && (best < 0 || (int32_t)(page(i)->sequence - page(best)->sequence) > 0))
+        {
+            best = (int32_t)i;
+        }
+    }
+    return best;
+}
+
+static uint64_t lastWrite;
+static int32_t savedPpb;
+static bool saved;
+
+bool drift_file_restore(void)
+{
+    int32_t i = newest();
+    if (i < 0)
+        return false;
+
+    const record_t *r = page(i);
+    clock_discipline_t d = *clock_discipline_state();
+    d.freq_ppb = (float)(r->freq_ppb - clock_discipline_get_base());
+    d.wander_ppb = (float)r->wander_ppb;
+    clock_discipline_restore(&d);
+    clock_discipline_set_base(clock_discipline_get_base());
+
+    savedPpb = r->freq_ppb;
+    saved = true;
+    printf("drift file: %.3f ppm (wander %.3f ppm)\n", -r->freq_ppb / 1000.0f, r->wander_ppb / 1000.0f);
+    return true;
+}
+
+typedef struct {
+    uint32_t index;
+    bool erase;
+    uint8_t data[FLASH_PAGE_SIZE];
+} write_t;
+
+// Erase and program run from RAM, the handlers of the Wi-Fi driver and the tick alarm wait
+static void write_page(const write_t *w)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    if (w->erase)
+    {
+        flash_range_erase(DRIFT_FILE_OFFSET, FLASH_SECTOR_SIZE);
+    }
+    flash_range_program(DRIFT_FILE_OFFSET + w->index * FLASH_PAGE_SIZE, w->data, FLASH_PAGE_SIZE);
+    restore_interrupts(irq);
+}
+
+void drift_file_service(void)
+{
+    const clock_discipline_t *d = clock_discipline_state();
+    uint64_t now = time_us_64();
+    int32_t ppb = (int32_t)d->freq_ppb + clock_discipline_get_base();
+
+    if (d->updates < 8 || d->wander_ppb > DRIFT_FILE_MAX_WANDER_PPB)
+        return;
+    if (lastWrite && now - lastWrite < DRIFT_FILE_INTERVAL_US)
+        return;
+    if (saved && ppb - savedPpb < DRIFT_FILE_MIN_CHANGE_PPB && savedPpb - ppb < DRIFT_FILE_MIN_CHANGE_PPB)
+        return;
+
+    // Next page after the newest record, the sector is erased when it is full
+    static write_t w;
+    int32_t last = newest();
+    w.index = last < 0 ? 0 : (uint32_t)(last + 1) % DRIFT_FILE_PAGES;
+    const uint32_t *words = (const uint32_t *)page(w.index);
+    w.erase = false;
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE / 4; i++)
+    {
+        w.erase |= words[i] != 0xffffffff;
+    }
+    if (w.erase)
+    {
+        w.index = 0;
+    }
+
+    record_t r;
+    r.magic = DRIFT_FILE_MAGIC;
+    r.sequence = last < 0 ? 0 : page(last)->sequence + 1;
+    r.freq_ppb = ppb;
+    r.wander_ppb = (uint32_t)d->wander_ppb;
+    r.checksum = checksum(&r);
+    memset(w.data, 0xff, sizeof(w.data));
+    memcpy(w.data, &r, sizeof(r));
+
+    lastWrite = now;
+    write_page(&w);
+    if (!valid(page(w.index)))
+    {
+        printf("drift file: write failed\n");
+        return;
+    }
+    savedPpb = ppb;
+    saved = true;
+}
@@ -0,0 +1,33 @@
+/* drift_file.h
+ *
+ * The frequency error of the crystal learned by the clock discipline, kept over power cycles in
+ * the last sector of the onboard flash, like ntpd's drift file. At boot the discipline starts
+ * with it, so after the first NTP step the clock already runs at the right rate.
+ *
+ * Records go to consecutive 256 byte pages of the sector, it is erased only when all 16 are
+ * used. Writes happen at most once an hour and only when the value changed, a sector lasts
+ * more than 100 years that way.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DRIFT_FILE_INTERVAL_US (3600ull * 1000000)  // At most one write per hour
+#define DRIFT_FILE_MIN_CHANGE_PPB 100               // Smaller changes are not written
+#define DRIFT_FILE_MAX_WANDER_PPB 2000              // Written only once the loop settled
+
+// Loads the last record into the clock discipline. False when there is none.
+bool drift_file_restore(void);
+
+// Writes the frequency when due, call once a minute from the main loop (not from interrupts,
+// interrupts are off for up to 50 ms while the sector is erased)
+void drift_file_service(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,120 @@
+/* ds3231.c
+ *
+ * Registers 0x00..0x06: seconds, minutes, hours, weekday, date, month (bit 7: century), year, in BCD.
+ * Status register 0x0F, bit 7 OSF: the oscillator stopped, e.g. the battery was empty.
+ */
+#include "pico/time.h"
+#include "ds3231.h"
+#include "civil_time.h"
+
+#define DS3231_REG_TIME 0x00
+#define DS3231_REG_STATUS 0x0F
+#define DS3231_STATUS_OSF 0x80
+
+// Readout is the start of the second, the true time is anywhere in it
+#define DS3231_ERROR_US 500000
+
+static uint8_t bcd(uint32_t v)
+{
+    return (uint8_t)((v / 10) << 4 | (v % 10));
+}
+
+static uint32_t unbcd(uint8_t v)
+{
+    return (v >> 4) * 10 + (v & 0x0F);
+}
+
+static bool read_registers(i2c_inst_t *i2c, uint8_t reg, uint8_t *data, uint32_t len)
+{
+    if (i2c_write_blocking(i2c, DS3231_ADDR, &reg, 1, true) != 1)
+        return false;
+    return i2c_read_blocking(i2c, DS3231_ADDR, data, len, false) == (int)len;
+}
+
+bool ds3231_read(i2c_inst_t *i2c, int64_t *utcSeconds)
+{
+    uint8_t status;
+    uint8_t r[7];
+
+    if (!read_registers(i2c, DS3231_REG_STATUS, &status, 1) || (status & DS3231_STATUS_OSF))
+        return false;
+    if (!read_registers(i2c, DS3231_REG_TIME, r, sizeof(r)))
+        return false;
+
+    civil_time_t t = {0};
+    t.second = unbcd(r[0] & 0x7F);
+    t.minute = unbcd(r[1] & 0x7F);
+    if (r[2] & 0x40)
+    {
+        // 12 hour mode, bit 5 is PM
+        t.hour = unbcd(r[2] & 0x1F) % 12 + ((r[2] & 0x20) ? 12 : 0);
+    }
+    else
+    {
+        t.hour = unbcd(r[2] & 0x3F);
+    }
+    t.day = unbcd(r[4] & 0x3F);
+    t.month = unbcd(r[5] & 0x1F);
+    t.year = 2000 + ((r[5] & 0x80) ? 100 : 0) + unbcd(r[6]);
+
+    if (t.second > 59 || t.minute > 59 || t.hour > 23 || t.month < 1 || t.month > 12 ||
+        t.day < 1 || t.day > civil_days_in_month(t.year, t.month))
+        return false;
+
+    *utcSeconds = civil_to_unix(&t);
+    return true;
+}
+
+bool ds3231_write(i2c_inst_t *i2c, int64_t utcSeconds)
+{
+    civil_time_t t;
+    civil_from_unix(utcSeconds, &t);
+    if (t.year < 2000 || t.year > 2199)
+        return false;
+
+    uint8_t w[8] = {
+        DS3231_REG_TIME,
+        bcd(t.second),
+        bcd(t.minute),
+        bcd(t.hour),                                // 24 hour mode
+        (uint8_t)(t.weekday + 1),                   // 1..7
+        bcd(t.day),
+        (uint8_t)(bcd(t.month) | (t.year >= 2100 ? 0x80 : 0)),
+        bcd(t.year % 100)
+    };
+    if (i2c_write_blocking(i2c, DS3231_ADDR, w, sizeof(w), false) != (int)sizeof(w))
+        return false;
+
+    uint8_t status;
+    if (!read_registers(i2c, DS3231_REG_STATUS, &status, 1))
+        return false;
+    uint8_t clear[2] = { DS3231_REG_STATUS, (uint8_t)(status & ~DS3231_STATUS_OSF) };
+    return i2c_write_blocking(i2c, DS3231_ADDR, clear, sizeof(clear), false) == (int)sizeof(clear);
+}
+
+//----------------------------------------------------------------------------------------
+// Time source
+
+static bool source_read(time_source_t *source, int64_t *utcUs, uint64_t *timerUs, uint32_t *errorUs)
+{
+    int64_t seconds;
+    if (!ds3231_read((i2c_inst_t *)source->context, &seconds))
+        return false;
+
+    *timerUs = time_us_64();
+    *utcUs = seconds * 1000000 + DS3231_ERROR_US;
+    *errorUs = DS3231_ERROR_US;
+    return true;
+}
+
+static bool source_write(time_source_t *source, int64_t utcSeconds)
+{
+    return ds3231_write((i2c_inst_t *)source->context, utcSeconds);
+}
+
+time_source_t *ds3231_time_source(i2c_inst_t *i2c)
+{
+    static time_source_t source = { "RTC", source_read, source_write, NULL };
+    source.context = i2c;
+    return &source;
+}
@@ -0,0 +1,32 @@
+/* ds3231.h
+ *
+ * DS3231 (and DS3232 / DS1307 compatible) battery backed real time clock on I2C, as a time source.
+ * It keeps UTC. The register interface has a resolution of one second, the chip restarts its second
+ * when the seconds register is written, so it is written on UTC second boundaries and read back
+ * as the middle of the current second.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/i2c.h"
+#include "time_source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DS3231_ADDR 0x68
+
+// Time as Unix seconds. Returns false when the chip does not answer or lost its time (oscillator stopped).
+bool ds3231_read(i2c_inst_t *i2c, int64_t *utcSeconds);
+
+// Sets the time and clears the oscillator stop flag, years 2000..2199
+bool ds3231_write(i2c_inst_t *i2c, int64_t utcSeconds);
+
+// The chip as time source for time_source_register()
+time_source_t *ds3231_time_source(i2c_inst_t *i2c);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,248 @@
+/* holdover.c
+ *
+ * The frequency error is measured over spans of at least HOLDOVER_MIN_SPAN, comparing NTP time
+ * against the raw timer, so neither clock steps nor the applied correction disturb it. With 1 ms
+ * NTP jitter a one hour span resolves about 0.3 ppm.
+ */
+#include <stdio.h>
+#include <math.h>
+
+#include "holdover.h"
+#include "timekeeping.h"
+#include "clock_discipline.h"
+
+#if !PICO_NO_HARDWARE
+#include "hardware/adc.h"
+#endif
+
+#define HOLDOVER_X0 25.0f                           // Fit around room temperature, keeps the sums small
+#define HOLDOVER_MAX_WEIGHT 16
+#define HOLDOVER_MIN_SPAN (3600LL * 1000000)        // µs
+#define HOLDOVER_MAX_PPM 200.0f                     // Anything beyond is a bad NTP answer, not the crystal
+#define HOLDOVER_EXTRAPOLATE 5.0f                   // °C beyond the learned range
+
+//----------------------------------------------------------------------------------------
+// Model
+
+void holdover_model_init(holdover_model_t *m)
+{
+    for (uint32_t i = 0; i < HOLDOVER_BINS; i++)
+    {
+        m->bin_temperature[i] = 0;
+        m->bin_ppm[i] = 0;
+        m->bin_weight[i] = 0;
+    }
+    m->a = m->b = m->c = 0;
+    m->t_min = m->t_max = 0;
+    m->bins = 0;
+    m->valid = false;
+}
+
+static float det3(float a11, float a12, float a13, float a21, float a22, float a23, float a31, float a32, float a33)
+{
+    return a11 * (a22 * a33 - a23 * a32) - a12 * (a21 * a33 - a23 * a31) + a13 * (a21 * a32 - a22 * a31);
+}
+
+// Weighted least squares over the bins, quadratic when there are 3 bins, else linear or constant
+static void fit(holdover_model_t *m)
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0, y0 = 0, y1 = 0, y2 = 0;
+
+    m->bins = 0;
+    for (uint32_t i = 0; i < HOLDOVER_BINS; i++)
+    {
+        if (!m->bin_weight[i])
+            continue;
+
+        float w = m->bin_weight[i];
+        float x = m->bin_temperature[i] - HOLDOVER_X0;
+        float y = m->bin_ppm[i];
+        s0 += w;
+        s1 += w * x;
+        s2 += w * x * x;
+        s3 += w * x * x * x;
+        s4 += w * x * x * x * x;
+        y0 += w * y;
+        y1 += w * x * y;
+        y2 += w * x * x * y;
+
+        if (!m->bins || m->bin_temperature[i] < m->t_min)
+            m->t_min = m->bin_temperature[i];
+        if (!m->bins || m->bin_temperature[i] > m->t_max)
+            m->t_max = m->bin_temperature[i];
+        m->bins++;
+    }
+
+    m->valid = m->bins > 0;
+    m->a = m->bins ? y0 / s0 : 0;
+    m->b = 0;
+    m->c = 0;
+
+    if (m->bins >= 3)
+    {
+        float d = det3(s0, s1, s2, s1, s2, s3, s2, s3, s4);
+        if (fabsf(d) > 1e-6f)
+        {
+            m->a = det3(y0, s1, s2, y1, s2, s3, y2, s3, s4) / d;
+            m->b = det3(s0, y0, s2, s1, y1, s3, s2, y2, s4) / d;
+            m->c = det3(s0, s1, y0, s1, s2, y1, s2, s3, y2) / d;
+            return;
+        }
+    }
+    if (m->bins >= 2)
+    {
+        float d = s0 * s2 - s1 * s1;
+        if (fabsf(d) > 1e-6f)
+        {
+            m->a = (y0 * s2 - y1 * s1) / d;
+            m->b = (s0 * y1 - s1 * y0) / d;
+        }
+    }
+}
+
+void holdover_model_learn(holdover_model_t *m, float temperature, float ppm)
+{
+    int bin = (int)floorf((temperature - HOLDOVER_BIN_MIN) / HOLDOVER_BIN_WIDTH);
+    if (bin < 0 || bin >= HOLDOVER_BINS)
+        return;
+
+    // Running mean over the last HOLDOVER_MAX_WEIGHT measurements of the bin
+    if (m->bin_weight[bin] < HOLDOVER_MAX_WEIGHT)
+        m->bin_weight[bin]++;
+    float k = 1.0f / m->bin_weight[bin];
+    m->bin_temperature[bin] += (temperature - m->bin_temperature[bin]) * k;
+    m->bin_ppm[bin] += (ppm - m->bin_ppm[bin]) * k;
+
+    fit(m);
+}
+
+bool holdover_model_predict(const holdover_model_t *m, float temperature, float *ppm)
+{
+    if (!m->valid)
+        return false;
+
+    // A parabola runs away quickly outside the measured range
+    float t = fminf(fmaxf(temperature, m->t_min - HOLDOVER_EXTRAPOLATE), m->t_max + HOLDOVER_EXTRAPOLATE);
+    float x = t - HOLDOVER_X0;
+    *ppm = m->a + m->b * x + m->c * x * x;
+    return true;
+}
+
+//----------------------------------------------------------------------------------------
+// Service
+
+static holdover_model_t model;
+static float temperature;
+static bool haveTemperature;
+static float predictedPpm;
+
+// Span of the current measurement
+static bool spanStarted;
+static int64_t spanNtpUs;
+static uint64_t spanTimerUs;
+static float spanTemperatureSum;
+static uint32_t spanSamples;
+
+void holdover_init(void)
+{
+    holdover_model_init(&model);
+#if !PICO_NO_HARDWARE
+    adc_init();
+    adc_set_temp_sensor_enabled(true);
+#endif
+}
+
+static float read_temperature(void)
+{
+#if !PICO_NO_HARDWARE
+    // Sensor is on ADC input 4: 0.706 V at 27 °C, -1.721 mV/°C
+    adc_select_input(4);
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        sum += adc_read();
+    }
+    float volts = sum * (3.3f / 4096 / 16);
+    return 27.0f - (volts - 0.706f) / 0.001721f;
+#else
+    return HOLDOVER_X0;
+#endif
+}
+
+float holdover_temperature(void)
+{
+    return temperature;
+}
+
+void holdover_sample(void)
+{
+    float t = read_temperature();
+    temperature = haveTemperature ? temperature + (t - temperature) * 0.1f : t;
+    haveTemperature = true;
+
+    if (spanStarted)
+    {
+        spanTemperatureSum += temperature;
+        spanSamples++;
+    }
+
+    float ppm;
+    if (holdover_model_predict(&model, temperature, &ppm))
+    {
+        predictedPpm = ppm;
+    }
+
+    // A fast crystal makes the timer count too many µs, the clock has to run slower.
+    // The NTP discipline adds what the model misses and its phase slew.
+    clock_discipline_set_base((int32_t)(-predictedPpm * 1000.0f));
+}
+
+static void start_span(int64_t ntpUs, uint64_t timerUs)
+{
+    spanStarted = true;
+    spanNtpUs = ntpUs;
+    spanTimerUs = timerUs;
+    spanTemperatureSum = 0;
+    spanSamples = 0;
+}
+
+void holdover_sync(int64_t ntpUs, uint64_t timerUs)
+{
+    if (!spanStarted)
+    {
+        start_span(ntpUs, timerUs);
+        return;
+    }
+
+    int64_t ntpElapsed = ntpUs - spanNtpUs;
+    if (ntpElapsed < HOLDOVER_MIN_SPAN)
+        return;
+
+    if (spanSamples)
+    {
+        int64_t timerElapsed = (int64_t)(timerUs - spanTimerUs);
+        float ppm = (float)(timerElapsed - ntpElapsed) * 1e6f / (float)ntpElapsed;
+        float t = spanTemperatureSum / spanSamples;
+        if (fabsf(ppm) < HOLDOVER_MAX_PPM)
+        {
+            holdover_model_learn(&model, t, ppm);
+            printf("holdover: %.2f ppm at %.1f C, %u bins\n", ppm, t, model.bins);
+        }
+    }
+    start_span(ntpUs, timerUs);
+}
+
+float holdover_ppm(void)
+{
+    return predictedPpm;
+}
+
+const holdover_model_t *holdover_model(void)
+{
+    return &model;
+}
+
+void holdover_set_model(const holdover_model_t *m)
+{
+    model = *m;
+}
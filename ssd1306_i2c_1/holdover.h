@@ -0,0 +1,62 @@
+/* holdover.h
+ *
+ * Temperature compensation of the crystal between NTP updates.
+ *
+ * The crystal frequency error depends mostly on temperature. Every NTP update measures the error
+ * over the time since the previous measurement (raw timer against NTP time) and files it under the
+ * mean die temperature of that span (ADC input 4). A quadratic ppm-versus-temperature curve is
+ * fitted through the collected points and its prediction for the current temperature is applied
+ * to the clock rate (timekeeping_set_rate()), so the clock keeps time while NTP is not reachable.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOLDOVER_BINS 50            // 2 °C wide, -20 .. 80 °C
+#define HOLDOVER_BIN_MIN (-20.0f)
+#define HOLDOVER_BIN_WIDTH 2.0f
+
+typedef struct {
+    float bin_temperature[HOLDOVER_BINS];   // Mean temperature of the measurements in the bin
+    float bin_ppm[HOLDOVER_BINS];
+    uint8_t bin_weight[HOLDOVER_BINS];      // Measurements in the bin, capped so old ones fade out
+    float a, b, c;                          // ppm = a + b * x + c * x^2, x = temperature - 25 °C
+    float t_min, t_max;                     // Learned temperature range, predictions are clamped near it
+    uint8_t bins;                           // Bins with measurements
+    bool valid;
+} holdover_model_t;
+
+// The model alone, without hardware
+void holdover_model_init(holdover_model_t *m);
+void holdover_model_learn(holdover_model_t *m, float temperature, float ppm);
+bool holdover_model_predict(const holdover_model_t *m, float temperature, float *ppm);
+
+// Enables the temperature sensor
+void holdover_init(void);
+
+// Die temperature in °C, low-pass filtered
+float holdover_temperature(void);
+
+// Reads the temperature and updates the clock rate correction, call every few seconds.
+// Also advances the phase slew of the clock discipline.
+void holdover_sample(void);
+
+// An NTP update: ntpUs was the true time when the timer read timerUs
+void holdover_sync(int64_t ntpUs, uint64_t timerUs);
+
+// Frequency error of the crystal predicted for the current temperature, ppm (positive = fast)
+float holdover_ppm(void);
+
+const holdover_model_t *holdover_model(void);
+
+// Replaces the learned model, e.g. with one kept over a reset
+void holdover_set_model(const holdover_model_t *m);
+
+#ifdef __cplusplus
+}
+#endif
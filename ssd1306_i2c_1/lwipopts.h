@@ -7,4 +7,10 @@
 // This example uses a common include to avoid repetition
 #include "../lwipopts_examples_common.h"
 
+// Multicast time beacons (time_beacon.c)
+#define LWIP_IGMP                   1
+
+// DHCP, DNS, dns_cache, ntp_client, sntp_server, time_beacon and two for ptp_client; the default is 4
+#define MEMP_NUM_UDP_PCB            8
+
 #endif
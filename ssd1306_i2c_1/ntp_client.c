@@ -0,0 +1,564 @@
+/* ntp_client.c
+ *
+ * The poll cycle runs on the async context of the cyw43 arch, where the lwIP callbacks run too:
+ * an at-time worker starts a poll, a second one ends it after the timeout, a when-pending worker
+ * ends it early once every server answered. With the background arch that context is an
+ * interrupt, so nothing there prints or touches the main loop's state (drift model, clock rate
+ * from the temperature): messages go to a small log and the result of a poll is applied to the
+ * clock by ntp_client_service(), as the tick alarm leaves its work to the main loop.
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "pico/cyw43_arch.h"
+#include "hardware/sync.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#include "timekeeping.h"
+#include "holdover.h"
+#include "civil_time.h"
+#include "ntp_packet.h"
+#include "ntp_select.h"
+#include "clock_discipline.h"
+#include "ntp_client.h"
+#include "dns_cache.h"
+
+#define NTP_VERSION 4
+#define NTP_MAX_BACKOFF 4               // RATE kisses: server polled at most every 2^4 poll intervals
+
+// Kiss codes, RFC 5905 7.4
+#define NTP_KISS(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+#define NTP_KISS_RATE NTP_KISS('R', 'A', 'T', 'E')
+#define NTP_KISS_DENY NTP_KISS('D', 'E', 'N', 'Y')
+#define NTP_KISS_RSTR NTP_KISS('R', 'S', 'T', 'R')
+
+// lwIP and Wi-Fi driver latency between the timer reads and the wire, added to the dispersion
+#define NTP_ERROR_US 2000
+
+typedef struct {
+    const char *hostname;
+    ip_addr_t address;
+    bool resolved;
+    bool resolving;
+    bool outstanding;           // Request sent, no reply yet
+    bool replied;               // Reply in this poll
+    uint8_t reach;              // Replies to the last 8 polls, one bit each
+    uint8_t stratum;
+    uint32_t root_delay_us;
+    uint8_t backoff;            // RATE kisses in a row
+    absolute_time_t hold_until; // Kissed: not polled before
+    struct pbuf *request;       // Allocated once, reused for every request
+    ntp_timestamp_t origin;     // Transmit timestamp of the request, the reply has to echo it
+    uint64_t request_timer_us;  // T1 on the timer
+    ntp_filter_t filter;
+} ntp_server_t;
+
+static ntp_server_t servers[NTP_CLIENT_MAX_SERVERS];
+static uint32_t serverCount;
+
+static struct udp_pcb *pcb;
+static bool polling;
+static bool suspended;
+static uint8_t failures;        // Polls in a row without a result
+static ntp_client_status_t status;
+
+static async_context_t *context;
+static async_at_time_worker_t pollWorker;
+static async_at_time_worker_t timeoutWorker;
+static async_when_pending_worker_t doneWorker;
+
+// Result of the last poll, for ntp_client_service()
+static volatile bool resultPending;
+static int64_t resultOffset;    // Plus the corrections applied until resultTimer
+static uint32_t resultDistance;
+static uint32_t resultSurvivors;
+static uint32_t resultCount;
+
+// Messages of the async context, printed by ntp_client_service()
+#define NTP_LOG_LINES 8
+#define NTP_LOG_LEN 100
+static char logLines[NTP_LOG_LINES][NTP_LOG_LEN];
+static volatile uint32_t logHead;
+static volatile uint32_t logTail;
+
+static time_source_t source = { "NTP", NULL, NULL, NULL };
+
+bool ntp_client_add_server(const char *hostname)
+{
+    if (serverCount >= NTP_CLIENT_MAX_SERVERS)
+        return false;
+    ntp_server_t *server = &servers[serverCount++];
+    memset(server, 0, sizeof(*server));
+    server->hostname = hostname;
+    ntp_filter_init(&server->filter);
+    return true;
+}
+
+time_source_t *ntp_client_time_source(void)
+{
+    return &source;
+}
+
+void ntp_client_status(ntp_client_status_t *s)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    *s = status;
+    s->synchronized = time_source_current() == &source;
+    restore_interrupts(irq);
+}
+
+// Only called in the async context, lines are dropped while the log is full
+static void ntp_log(const char *format, ...)
+{
+    if (logHead - logTail >= NTP_LOG_LINES)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(logLines[logHead % NTP_LOG_LINES], NTP_LOG_LEN, format, args);
+    va_end(args);
+    __dmb();
+    logHead++;
+}
+
+//----------------------------------------------------------------------------------------
+// Requests and replies, lwIP context
+
+static bool all_answered(void)
+{
+    for (uint32_t i = 0; i < serverCount; i++)
+    {
+        if (servers[i].outstanding || servers[i].resolving)
+            return false;
+    }
+    return true;
+}
+
+// Ends the poll early, from the async context and not from within the lwIP callback
+static void check_done(void)
+{
+    if (polling && all_answered())
+    {
+        async_context_set_work_pending(context, &doneWorker);
+    }
+}
+
+static void send_request(ntp_server_t *server)
+{
+    struct pbuf *p = server->request;
+    if (p->ref > 1)
+    {
+        // Previous request still queued, e.g. waiting for ARP
+        return;
+    }
+
+    // udp_sendto() leaves the UDP and IP headers in front of the payload
+    pbuf_remove_header(p, p->tot_len - NTP_PACKET_LEN);
+
+    // The transmit timestamp only has to be unique, the reply echoes it as origin.
+    // T1 itself is taken from the timer, so the clock need not be set.
+    server->request_timer_us = time_us_64();
+    server->origin = ntp_timestamp_from_unix_us(timekeeping_is_set() ? timekeeping_realtime_at(server->request_timer_us)
+                                                                     : (int64_t)server->request_timer_us);
+
+    ntp_packet_t request;
+    memset(&request, 0, sizeof(request));
+    request.version = NTP_VERSION;
+    request.mode = NTP_MODE_CLIENT;
+    request.transmit = server->origin;
+    ntp_packet_encode(&request, (uint8_t *)p->payload);
+
+    if (udp_sendto(pcb, p, &server->address, NTP_PORT) == ERR_OK)
+    {
+        server->outstanding = true;
+    }
+}
+
+static void dns_found(const char *hostname, const ip_addr_t *ipaddr, void *arg)
+{
+    ntp_server_t *server = (ntp_server_t *)arg;
+    server->resolving = false;
+    if (ipaddr)
+    {
+        server->address = *ipaddr;
+        server->resolved = true;
+        ntp_log("ntp %s: %s\n", hostname, ipaddr_ntoa(ipaddr));
+        if (polling)
+        {
+            send_request(server);
+        }
+    }
+    else
+    {
+        ntp_log("ntp %s: dns request failed\n", hostname);
+    }
+    check_done();
+}
+
+static void kiss(ntp_server_t *server, uint32_t code)
+{
+    uint32_t pollMs = clock_discipline_poll_s() * 1000;
+    if (code == NTP_KISS_RATE)
+    {
+        // Too often: back off from this server only
+        if (server->backoff < NTP_MAX_BACKOFF)
+        {
+            server->backoff++;
+        }
+        server->hold_until = make_timeout_time_ms(pollMs << server->backoff);
+        ntp_log("ntp %s: rate limited, backing off %u s\n", server->hostname, (unsigned)((pollMs << server->backoff) / 1000));
+    }
+    else if (code == NTP_KISS_DENY || code == NTP_KISS_RSTR)
+    {
+        // Not welcome at this address: try the next one of the name much later
+        server->resolved = false;
+        server->backoff = NTP_MAX_BACKOFF;
+        server->hold_until = make_timeout_time_ms(pollMs << NTP_MAX_BACKOFF);
+        ntp_filter_init(&server->filter);
+        ntp_log("ntp %s: access denied\n", server->hostname);
+    }
+}
+
+static ntp_server_t *find_server(const ip_addr_t *addr, ntp_timestamp_t origin)
+{
+    for (uint32_t i = 0; i < serverCount; i++)
+    {
+        ntp_server_t *server = &servers[i];
+        if (server->outstanding && server->origin == origin && ip_addr_cmp(addr, &server->address))
+            return server;
+    }
+    return NULL;
+}
+
+static void ntp_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    (void)arg;
+    (void)upcb;
+    uint64_t received = time_us_64();  // T4, as early as possible
+
+    uint8_t buf[NTP_PACKET_LEN];
+    ntp_packet_t reply;
+    if (port != NTP_PORT || p->tot_len != NTP_PACKET_LEN || pbuf_copy_partial(p, buf, NTP_PACKET_LEN, 0) != NTP_PACKET_LEN)
+    {
+        pbuf_free(p);
+        return;
+    }
+    pbuf_free(p);
+    ntp_packet_decode(&reply, buf);
+
+    // A reply that does not echo our transmit timestamp is a late duplicate or forged
+    ntp_server_t *server = find_server(addr, reply.origin);
+    if (!server)
+        return;
+    server->outstanding = false;
+    check_done();
+
+    if (reply.mode == NTP_MODE_SERVER && reply.stratum == 0)
+    {
+        kiss(server, reply.reference_id);
+        return;
+    }
+
+    if (reply.mode != NTP_MODE_SERVER || reply.leap == NTP_LEAP_UNSYNCHRONIZED || reply.transmit == 0)
+    {
+        ntp_log("ntp %s: invalid response\n", server->hostname);
+        return;
+    }
+
+    // T2 and T3 are server time, T1 and T4 the timer: the timer difference is the round trip
+    int64_t pivot = timekeeping_is_set() ? timekeeping_realtime_at(received) : NTP_DEFAULT_PIVOT_US;
+    int64_t t2 = ntp_timestamp_to_unix_us(reply.receive, pivot);
+    int64_t t3 = ntp_timestamp_to_unix_us(reply.transmit, pivot);
+    int64_t delay = (int64_t)(received - server->request_timer_us) - (t3 - t2);
+    if (delay < 0)
+    {
+        delay = 0;
+    }
+
+    // Reply took half of the round trip. The offset keeps the corrections applied so far, so it
+    // can be compared to the clock after later slews and steps.
+    ntp_sample_t sample;
+    sample.offset_us = t3 + delay / 2 - timekeeping_realtime_at(received) + clock_discipline_correction_us(received);
+    sample.timer_us = received;
+    sample.delay_us = (uint32_t)delay;
+    sample.dispersion_us = ntp_short_to_us(reply.root_delay) / 2 + ntp_short_to_us(reply.root_dispersion) + NTP_ERROR_US;
+    ntp_filter_add(&server->filter, &sample);
+
+    server->stratum = reply.stratum;
+    server->root_delay_us = ntp_short_to_us(reply.root_delay);
+    server->backoff = 0;
+    server->replied = true;
+}
+
+//----------------------------------------------------------------------------------------
+// Poll cycle, async context
+
+static void start_poll(void)
+{
+    polling = true;
+
+    for (uint32_t i = 0; i < serverCount; i++)
+    {
+        ntp_server_t *server = &servers[i];
+        server->replied = false;
+        server->outstanding = false;
+
+        if (absolute_time_diff_us(get_absolute_time(), server->hold_until) > 0)
+        {
+            // Kissed
+        }
+        else if (server->resolved)
+        {
+            send_request(server);
+        }
+        else if (!server->resolving)
+        {
+            // Cached or an address literal: ERR_OK right away, else the callback sends the request
+            server->resolving = true;
+            err_t err = dns_cache_resolve(server->hostname, &server->address, dns_found, server);
+            if (err == ERR_OK)
+            {
+                server->resolving = false;
+                server->resolved = true;
+                send_request(server);
+            }
+            else if (err != ERR_INPROGRESS)
+            {
+                server->resolving = false;
+                ntp_log("ntp %s: dns request failed\n", server->hostname);
+            }
+        }
+    }
+}
+
+// Poll interval after a result, exponential backoff after failures. A random part of up to an
+// eighth spreads out clocks that were started together, e.g. after a power cut.
+static void schedule_poll(bool success)
+{
+    uint32_t delay = clock_discipline_poll_s() * 1000;
+    if (success)
+    {
+        failures = 0;
+    }
+    else
+    {
+        uint32_t retry = NTP_CLIENT_RETRY_MS << (failures < 8 ? failures : 8);
+        delay = retry < delay ? retry : delay;
+        if (failures < UINT8_MAX)
+        {
+            failures++;
+        }
+    }
+    async_context_add_at_time_worker_in_ms(context, &pollWorker, delay + LWIP_RAND() % (delay / 8 + 1));
+}
+
+static void end_poll(void)
+{
+    polling = false;
+    async_context_remove_at_time_worker(context, &timeoutWorker);
+
+    ntp_estimate_t estimates[NTP_CLIENT_MAX_SERVERS];
+    ntp_server_t *candidates[NTP_CLIENT_MAX_SERVERS];
+    uint32_t count = 0;
+    uint64_t now = time_us_64();
+    int64_t correction = clock_discipline_correction_us(now);
+
+    for (uint32_t i = 0; i < serverCount; i++)
+    {
+        ntp_server_t *server = &servers[i];
+        server->outstanding = false;
+        server->reach = server->reach << 1 | server->replied;
+
+        // Silent for 8 polls: take the next address of the name, the DNS cache hands them out in turn
+        if (!server->reach && server->resolved && server->filter.count)
+        {
+            server->resolved = false;
+            ntp_filter_init(&server->filter);
+        }
+
+        if (server->reach && ntp_filter_estimate(&server->filter, correction, now, &estimates[count]))
+        {
+            candidates[count++] = server;
+        }
+    }
+
+    bool truechimer[NTP_CLIENT_MAX_SERVERS];
+    uint32_t survivors = ntp_select(estimates, count, truechimer);
+    int64_t offset;
+    uint32_t distance;
+    if (!survivors || !ntp_combine(estimates, truechimer, count, &offset, &distance))
+    {
+        ntp_log("ntp: no agreement among %u servers\n", (unsigned)count);
+        schedule_poll(false);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ntp_log("ntp %s: stratum %u, offset %lld us, delay %u us, jitter %u us%s\n", candidates[i]->hostname,
+                candidates[i]->stratum, (long long)estimates[i].offset_us, (unsigned)estimates[i].delay_us,
+                (unsigned)estimates[i].jitter_us, truechimer[i] ? "" : ", falseticker");
+    }
+
+    // The server with the shortest distance is the reference passed on to our own clients
+    uint32_t peer = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (truechimer[i] && (!truechimer[peer] || estimates[i].distance_us < estimates[peer].distance_us))
+        {
+            peer = i;
+        }
+    }
+    uint32_t irq = save_and_disable_interrupts();
+    status.stratum = candidates[peer]->stratum;
+    status.reference_id = lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(&candidates[peer]->address)));
+    status.root_delay_us = candidates[peer]->root_delay_us + estimates[peer].delay_us;
+    status.reference_us = timekeeping_realtime_at(now) + offset;
+    restore_interrupts(irq);
+
+    // The main loop applies it, the offset keeps the corrections until now like the samples do
+    resultOffset = offset + correction;
+    resultDistance = distance;
+    resultSurvivors = survivors;
+    resultCount = count;
+    __dmb();
+    resultPending = true;
+    __sev();
+
+    schedule_poll(true);
+}
+
+static void poll_work(async_context_t *ctx, async_at_time_worker_t *worker)
+{
+    (void)worker;
+    if (suspended || polling)
+        return;
+
+    start_poll();
+    async_context_add_at_time_worker_in_ms(ctx, &timeoutWorker, NTP_CLIENT_TIMEOUT_MS);
+    check_done();
+}
+
+static void timeout_work(async_context_t *ctx, async_at_time_worker_t *worker)
+{
+    (void)ctx;
+    (void)worker;
+    if (polling)
+    {
+        end_poll();
+    }
+}
+
+static void done_work(async_context_t *ctx, async_when_pending_worker_t *worker)
+{
+    (void)ctx;
+    (void)worker;
+    if (polling && all_answered())
+    {
+        end_poll();
+    }
+}
+
+bool ntp_client_init(void)
+{
+    context = cyw43_arch_async_context();
+    pollWorker.do_work = poll_work;
+    timeoutWorker.do_work = timeout_work;
+    doneWorker.do_work = done_work;
+
+    cyw43_arch_lwip_begin();
+    pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb)
+    {
+        cyw43_arch_lwip_end();
+        printf("failed to create pcb\n");
+        return false;
+    }
+    udp_recv(pcb, ntp_recv, NULL);
+
+    for (uint32_t i = 0; i < serverCount; i++)
+    {
+        servers[i].request = pbuf_alloc(PBUF_TRANSPORT, NTP_PACKET_LEN, PBUF_RAM);
+        if (!servers[i].request)
+        {
+            cyw43_arch_lwip_end();
+            printf("failed to allocate request\n");
+            return false;
+        }
+    }
+
+    async_context_add_when_pending_worker(context, &doneWorker);
+    async_context_add_at_time_worker_in_ms(context, &pollWorker, 0);
+    cyw43_arch_lwip_end();
+    return true;
+}
+
+void ntp_client_suspend(bool suspend)
+{
+    if (!context)
+    {
+        suspended = suspend;
+        return;
+    }
+
+    cyw43_arch_lwip_begin();
+    if (suspended && !suspend)
+    {
+        async_context_remove_at_time_worker(context, &pollWorker);
+        async_context_add_at_time_worker_in_ms(context, &pollWorker, 0);
+    }
+    suspended = suspend;
+    cyw43_arch_lwip_end();
+}
+
+//----------------------------------------------------------------------------------------
+// Main loop
+
+static void apply_result(void)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    resultPending = false;
+    uint64_t now = time_us_64();
+    int64_t offset = resultOffset - clock_discipline_correction_us(now);
+    uint32_t distance = resultDistance;
+    uint32_t survivors = resultSurvivors;
+    uint32_t count = resultCount;
+    restore_interrupts(irq);
+
+    // The drift model learns from the true time
+    int64_t utcUs = timekeeping_realtime_at(now) + offset;
+    holdover_sync(utcUs, now);
+
+    // Small offsets of a clock that already follows NTP are slewed out, the rest is a step. A sample too far
+    // off to slew and too rough to step the clock is dropped, the slew of the earlier ones goes on.
+    if (time_source_current() == &source && clock_discipline_offset(offset, now))
+    {
+        time_source_confirm(&source, now, distance);
+    }
+    else if (time_source_offer(&source, utcUs, now, distance))
+    {
+        clock_discipline_step(offset);
+    }
+
+    civil_time_t utc;
+    civil_from_unix(utcUs / 1000000, &utc);
+    printf("got ntp response: %02d/%02d/%04d %02d:%02d:%02d, %u of %u servers, distance %u us\n", utc.day, utc.month,
+           (int)utc.year, utc.hour, utc.minute, utc.second, (unsigned)survivors, (unsigned)count, (unsigned)distance);
+}
+
+void ntp_client_service(void)
+{
+    while (logTail != logHead)
+    {
+        __dmb();
+        printf("%s", logLines[logTail % NTP_LOG_LINES]);
+        logTail++;
+    }
+
+    if (resultPending)
+    {
+        apply_result();
+    }
+}
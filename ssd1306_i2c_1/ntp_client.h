@@ -0,0 +1,62 @@
+/* ntp_client.h
+ *
+ * NTP client querying several servers at once from one UDP pcb (lwIP raw API).
+ *
+ * Every poll sends a request to each server, replies are collected for a few seconds. Each server
+ * keeps an 8 sample filter, falsetickers are voted out (ntp_select.c) and the remaining servers
+ * are combined into one offer to the time source selection. A single lost reply or a bad server
+ * no longer costs the whole cycle.
+ *
+ * Small offsets are slewed out by the clock discipline (clock_discipline.c), which also sets the
+ * poll interval (64 .. 1024 s). Failed polls are retried with exponential backoff, all delays get
+ * a random part so clocks powered up together do not hit the servers at the same moment.
+ * Kiss-o'-Death replies are honoured: RATE backs off from that server, DENY and RSTR drop it.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "time_source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NTP_CLIENT_MAX_SERVERS 6
+#define NTP_CLIENT_RETRY_MS 4000        // First retry after a failed poll, doubles up to the poll interval
+#define NTP_CLIENT_TIMEOUT_MS 3000      // Replies later than this are dropped
+
+// Hostname or address, e.g. "0.pool.ntp.org" or "192.168.1.1". The string must stay valid.
+bool ntp_client_add_server(const char *hostname);
+
+// Creates the pcb and the request buffers and starts polling on the async context of the cyw43
+// arch, call after cyw43_arch_init(). Polls run by themselves in the poll and background arch.
+bool ntp_client_init(void);
+
+// Sets the clock from the last poll and prints the client's messages, never blocks.
+// Call from the main loop.
+void ntp_client_service(void);
+
+// No new polls while suspended, e.g. while another clock passes its time on (time_beacon.c).
+// Resuming polls right away. Call from the main loop.
+void ntp_client_suspend(bool suspend);
+
+// The source NTP offers its results to, register it with time_source_register()
+time_source_t *ntp_client_time_source(void);
+
+// What a server needs to tell its clients about our synchronization (sntp_server.c)
+typedef struct {
+    bool synchronized;          // NTP is the current time source
+    uint8_t stratum;            // Of the server with the shortest distance (system peer)
+    uint32_t reference_id;      // IPv4 address of the system peer
+    uint32_t root_delay_us;     // Round trip to the reference clock at the root
+    int64_t reference_us;       // UTC of the last clock update
+} ntp_client_status_t;
+
+// May be called from interrupt handlers
+void ntp_client_status(ntp_client_status_t *status);
+
+#ifdef __cplusplus
+}
+#endif
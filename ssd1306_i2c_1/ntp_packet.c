@@ -0,0 +1,103 @@
+/* ntp_packet.c
+ */
+#include "ntp_packet.h"
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static ntp_timestamp_t get64(const uint8_t *p)
+{
+    return (ntp_timestamp_t)get32(p) << 32 | get32(p + 4);
+}
+
+static void put64(uint8_t *p, ntp_timestamp_t v)
+{
+    put32(p, v >> 32);
+    put32(p + 4, (uint32_t)v);
+}
+
+void ntp_packet_encode(const ntp_packet_t *packet, uint8_t *buf)
+{
+    buf[0] = (packet->leap & 3) << 6 | (packet->version & 7) << 3 | (packet->mode & 7);
+    buf[1] = packet->stratum;
+    buf[2] = (uint8_t)packet->poll;
+    buf[3] = (uint8_t)packet->precision;
+    put32(buf + 4, packet->root_delay);
+    put32(buf + 8, packet->root_dispersion);
+    put32(buf + 12, packet->reference_id);
+    put64(buf + 16, packet->reference);
+    put64(buf + 24, packet->origin);
+    put64(buf + 32, packet->receive);
+    put64(buf + 40, packet->transmit);
+}
+
+void ntp_packet_decode(ntp_packet_t *packet, const uint8_t *buf)
+{
+    packet->leap = buf[0] >> 6;
+    packet->version = (buf[0] >> 3) & 7;
+    packet->mode = buf[0] & 7;
+    packet->stratum = buf[1];
+    packet->poll = (int8_t)buf[2];
+    packet->precision = (int8_t)buf[3];
+    packet->root_delay = get32(buf + 4);
+    packet->root_dispersion = get32(buf + 8);
+    packet->reference_id = get32(buf + 12);
+    packet->reference = get64(buf + 16);
+    packet->origin = get64(buf + 24);
+    packet->receive = get64(buf + 32);
+    packet->transmit = get64(buf + 40);
+}
+
+ntp_timestamp_t ntp_timestamp_from_unix_us(int64_t utcUs)
+{
+    // Floor division, also right for times before 1970
+    int64_t seconds = utcUs / 1000000;
+    int64_t us = utcUs % 1000000;
+    if (us < 0)
+    {
+        seconds--;
+        us += 1000000;
+    }
+
+    // Seconds wrap into the 32-bit era on purpose
+    uint32_t ntpSeconds = (uint32_t)(seconds + NTP_DELTA);
+    uint32_t fraction = (uint32_t)(((uint64_t)us << 32) / 1000000);
+    return (ntp_timestamp_t)ntpSeconds << 32 | fraction;
+}
+
+int64_t ntp_timestamp_to_unix_us(ntp_timestamp_t timestamp, int64_t pivotUs)
+{
+    // Distance to the pivot in 32.32 seconds, the wrap of the subtraction picks the nearest era
+    int64_t diff = (int64_t)(timestamp - ntp_timestamp_from_unix_us(pivotUs));
+    int64_t seconds = diff >> 32;
+    uint32_t fraction = (uint32_t)diff;
+
+    // Rounded to the nearest µs, the fraction has 233 ps resolution
+    return pivotUs + seconds * 1000000 + (int64_t)(((uint64_t)fraction * 1000000 + (1u << 31)) >> 32);
+}
+
+uint32_t ntp_short_to_us(uint32_t value)
+{
+    return (uint32_t)(((uint64_t)value * 1000000) >> 16);
+}
+
+uint32_t ntp_short_from_us(uint32_t us)
+{
+    return (uint32_t)(((uint64_t)us << 16) / 1000000);
+}
+
+void ntp_on_wire(int64_t t1, int64_t t2, int64_t t3, int64_t t4, int64_t *offsetUs, int64_t *delayUs)
+{
+    *offsetUs = ((t2 - t1) + (t3 - t4)) / 2;
+    *delayUs = (t4 - t1) - (t3 - t2);
+}
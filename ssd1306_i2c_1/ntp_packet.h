@@ -0,0 +1,66 @@
+/* ntp_packet.h
+ *
+ * NTP wire format (RFC 5905): 48 byte header, 32.32 fixed point timestamps and the on-wire
+ * offset / delay computation.
+ *
+ * NTP seconds are 32 bits and wrap every 136 years (next in February 2036). A timestamp is
+ * therefore converted relative to a pivot time, the result is the instant within ±68 years of it.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NTP_PACKET_LEN 48
+#define NTP_PORT 123
+#define NTP_DELTA 2208988800u   // seconds between 1 Jan 1900 and 1 Jan 1970
+
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_LEAP_UNSYNCHRONIZED 3
+
+// Pivot while the clock is not set, 2020-01-01: timestamps of 1952..2088 convert correctly
+#define NTP_DEFAULT_PIVOT_US (1577836800ll * 1000000)
+
+// Seconds since 1900 in the upper 32 bits, fraction of a second in the lower 32 bits
+typedef uint64_t ntp_timestamp_t;
+
+typedef struct {
+    uint8_t leap;               // 0..2, 3 = server not synchronized
+    uint8_t version;
+    uint8_t mode;               // NTP_MODE_*
+    uint8_t stratum;            // 0 = Kiss-o'-Death, 1 = reference clock, 2.. = via NTP
+    int8_t poll;                // log2 s
+    int8_t precision;           // log2 s
+    uint32_t root_delay;        // 16.16 s
+    uint32_t root_dispersion;   // 16.16 s
+    uint32_t reference_id;      // IPv4 address or 4 ASCII characters (stratum 0 and 1)
+    ntp_timestamp_t reference;
+    ntp_timestamp_t origin;     // T1, copied by the server from the transmit timestamp of the request
+    ntp_timestamp_t receive;    // T2
+    ntp_timestamp_t transmit;   // T3
+} ntp_packet_t;
+
+void ntp_packet_encode(const ntp_packet_t *packet, uint8_t *buf);
+void ntp_packet_decode(ntp_packet_t *packet, const uint8_t *buf);
+
+// UTC µs since 1970 to a timestamp and back; pivotUs chooses the 136 year era
+ntp_timestamp_t ntp_timestamp_from_unix_us(int64_t utcUs);
+int64_t ntp_timestamp_to_unix_us(ntp_timestamp_t timestamp, int64_t pivotUs);
+
+// 16.16 short format to µs and back
+uint32_t ntp_short_to_us(uint32_t value);
+uint32_t ntp_short_from_us(uint32_t us);
+
+// RFC 5905 on-wire calculation. t1/t4 are client transmit/receive, t2/t3 server receive/transmit,
+// all UTC µs. Offset is what the client clock has to be corrected by, delay the round trip without
+// the time the server held the request.
+void ntp_on_wire(int64_t t1, int64_t t2, int64_t t3, int64_t t4, int64_t *offsetUs, int64_t *delayUs);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,184 @@
+/* ntp_select.c
+ *
+ * Simplified from RFC 5905 A.5.2 - A.5.5: no cluster algorithm, the few servers of a small
+ * client are all combined once the falsetickers are gone.
+ */
+#include <math.h>
+#include <string.h>
+
+#include "ntp_select.h"
+
+#define NTP_MAX_CANDIDATES 8
+
+void ntp_filter_init(ntp_filter_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+void ntp_filter_add(ntp_filter_t *filter, const ntp_sample_t *sample)
+{
+    filter->samples[filter->next] = *sample;
+    filter->next = (filter->next + 1) % NTP_FILTER_SAMPLES;
+    if (filter->count < NTP_FILTER_SAMPLES)
+    {
+        filter->count++;
+    }
+}
+
+bool ntp_filter_estimate(const ntp_filter_t *filter, int64_t correctionUs, uint64_t nowTimerUs, ntp_estimate_t *estimate)
+{
+    if (!filter->count)
+        return false;
+
+    // What the clock was corrected by since a sample is no longer part of its offset
+    int64_t offsets[NTP_FILTER_SAMPLES];
+    uint32_t best = 0;
+    for (uint32_t i = 0; i < filter->count; i++)
+    {
+        const ntp_sample_t *s = &filter->samples[i];
+        offsets[i] = s->offset_us - correctionUs;
+        if (s->delay_us < filter->samples[best].delay_us)
+        {
+            best = i;
+        }
+    }
+
+    const ntp_sample_t *chosen = &filter->samples[best];
+    uint64_t age = nowTimerUs - chosen->timer_us;
+
+    float sum = 0;
+    for (uint32_t i = 0; i < filter->count; i++)
+    {
+        float d = (float)(offsets[i] - offsets[best]);
+        sum += d * d;
+    }
+
+    estimate->offset_us = offsets[best];
+    estimate->delay_us = chosen->delay_us;
+    estimate->dispersion_us = chosen->dispersion_us + (uint32_t)(age * NTP_PHI_PPM / 1000000);
+    estimate->jitter_us = filter->count > 1 ? (uint32_t)sqrtf(sum / (filter->count - 1)) : 0;
+    estimate->distance_us = estimate->delay_us / 2 + estimate->dispersion_us + estimate->jitter_us;
+    return true;
+}
+
+typedef struct {
+    int64_t edge;
+    int8_t type;    // +1 lower end, 0 offset, -1 upper end
+} endpoint_t;
+
+uint32_t ntp_select(const ntp_estimate_t *estimates, uint32_t count, bool *truechimer)
+{
+    endpoint_t points[3 * NTP_MAX_CANDIDATES];
+    uint32_t n = count < NTP_MAX_CANDIDATES ? count : NTP_MAX_CANDIDATES;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        truechimer[i] = false;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        points[3 * i] = (endpoint_t){ estimates[i].offset_us - estimates[i].distance_us, +1 };
+        points[3 * i + 1] = (endpoint_t){ estimates[i].offset_us, 0 };
+        points[3 * i + 2] = (endpoint_t){ estimates[i].offset_us + estimates[i].distance_us, -1 };
+    }
+
+    // Insertion sort, at most 24 points
+    for (uint32_t i = 1; i < 3 * n; i++)
+    {
+        endpoint_t p = points[i];
+        uint32_t j = i;
+        while (j > 0 && points[j - 1].edge > p.edge)
+        {
+            points[j] = points[j - 1];
+            j--;
+        }
+        points[j] = p;
+    }
+
+    // Smallest number of falsetickers that leaves an interval shared by all the others,
+    // containing the offsets of at least those
+    int64_t low = 0, high = 0;
+    bool found = false;
+    for (uint32_t allow = 0; 2 * allow < n && !found; allow++)
+    {
+        int32_t chime = 0;
+        uint32_t outside = 0;
+        for (uint32_t i = 0; i < 3 * n; i++)
+        {
+            chime += points[i].type;
+            if (chime >= (int32_t)(n - allow))
+            {
+                low = points[i].edge;
+                break;
+            }
+            if (points[i].type == 0)
+            {
+                outside++;
+            }
+        }
+
+        chime = 0;
+        for (uint32_t i = 3 * n; i-- > 0;)
+        {
+            chime -= points[i].type;
+            if (chime >= (int32_t)(n - allow))
+            {
+                high = points[i].edge;
+                break;
+            }
+            if (points[i].type == 0)
+            {
+                outside++;
+            }
+        }
+
+        found = outside <= allow && low <= high;
+    }
+
+    if (!found)
+        return 0;
+
+    uint32_t survivors = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const ntp_estimate_t *e = &estimates[i];
+        // RFC 5905: the offset itself lies in the intersection, overlapping it is not enough
+        truechimer[i] = e->offset_us >= low && e->offset_us <= high;
+        survivors += truechimer[i];
+    }
+    return survivors;
+}
+
+bool ntp_combine(const ntp_estimate_t *estimates, const bool *truechimer, uint32_t count,
+                 int64_t *offsetUs, uint32_t *distanceUs)
+{
+    // Relative to the first truechimer, the float keeps the µs of the difference only
+    float weights = 0, sum = 0;
+    int64_t base = 0;
+    uint32_t best = UINT32_MAX;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!truechimer[i])
+            continue;
+        if (best == UINT32_MAX)
+        {
+            base = estimates[i].offset_us;
+        }
+        if (best == UINT32_MAX || estimates[i].distance_us < best)
+        {
+            best = estimates[i].distance_us;
+        }
+        float w = 1.0f / (float)(estimates[i].distance_us + 1);
+        weights += w;
+        sum += w * (float)(estimates[i].offset_us - base);
+    }
+
+    if (best == UINT32_MAX)
+        return false;
+
+    *offsetUs = base + (int64_t)(sum / weights);
+    *distanceUs = best;
+    return true;
+}
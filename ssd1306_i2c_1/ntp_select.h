@@ -0,0 +1,60 @@
+/* ntp_select.h
+ *
+ * Clock filter, selection and combining of RFC 5905, without the networking.
+ *
+ * Every server keeps its last 8 samples. The one with the shortest round trip is the least
+ * disturbed by queuing in the network and becomes the server's estimate, with an interval of
+ * ± root distance around it in which the true time lies. The intersection algorithm (Marzullo)
+ * finds the interval shared by the majority of servers; servers outside of it (falsetickers)
+ * are discarded and the remaining ones averaged, weighted by their distance.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NTP_FILTER_SAMPLES 8
+#define NTP_PHI_PPM 15          // Assumed frequency error, grows the dispersion of old samples
+
+typedef struct {
+    int64_t offset_us;          // Server time - local clock at T4, plus the corrections applied until then
+    uint64_t timer_us;          // T4
+    uint32_t delay_us;          // Round trip without the server hold time
+    uint32_t dispersion_us;     // Root delay / 2 + root dispersion of the server and local errors
+} ntp_sample_t;
+
+typedef struct {
+    ntp_sample_t samples[NTP_FILTER_SAMPLES];
+    uint8_t next;
+    uint8_t count;
+} ntp_filter_t;
+
+typedef struct {
+    int64_t offset_us;          // Correction of the local clock
+    uint32_t delay_us;
+    uint32_t dispersion_us;
+    uint32_t jitter_us;         // RMS of the other offsets against the chosen one
+    uint32_t distance_us;       // delay / 2 + dispersion + jitter, half width of the interval
+} ntp_estimate_t;
+
+void ntp_filter_init(ntp_filter_t *filter);
+void ntp_filter_add(ntp_filter_t *filter, const ntp_sample_t *sample);
+
+// Estimate from the sample with the shortest delay. correctionUs: corrections applied to the local
+// clock up to now (steps and slews), they are no longer part of the offset. False without samples.
+bool ntp_filter_estimate(const ntp_filter_t *filter, int64_t correctionUs, uint64_t nowTimerUs, ntp_estimate_t *estimate);
+
+// Marks the truechimers, returns their count. 0 when no majority agrees.
+uint32_t ntp_select(const ntp_estimate_t *estimates, uint32_t count, bool *truechimer);
+
+// Distance weighted mean offset of the truechimers; the distance is the one of the best of them
+bool ntp_combine(const ntp_estimate_t *estimates, const bool *truechimer, uint32_t count,
+                 int64_t *offsetUs, uint32_t *distanceUs);
+
+#ifdef __cplusplus
+}
+#endif
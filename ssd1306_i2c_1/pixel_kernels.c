@@ -0,0 +1,193 @@
+/* pixel_kernels.c
+ *
+ * The interpolators do the address generation: a lane extracts one byte of the accumulator
+ * (shift + mask) and adds the table base, so a lookup is one register read and one load.
+ * Interpolator 0 handles bytes 0 and 1 of a word, interpolator 1 bytes 2 and 3.
+ */
+#include <stdio.h>
+#include <math.h>
+
+#include "pixel_kernels.h"
+
+#if !PICO_NO_HARDWARE
+#include "hardware/interp.h"
+#include "pico/time.h"
+#endif
+
+void pixel_lut_build(uint8_t lut[256], uint brightness, float gamma)
+{
+    for (uint i = 0; i < 256; i++)
+    {
+        float v = i / 255.0f;
+        if (gamma != 1.0f)
+        {
+            v = powf(v, gamma);
+        }
+        lut[i] = (uint8_t)((uint)(v * 255.0f + 0.5f) * brightness >> 8);
+    }
+}
+
+void pixel_lut_apply_c(uint8_t *data, uint bytes, const uint8_t lut[256])
+{
+    for (uint i = 0; i < bytes; i++)
+    {
+        data[i] = lut[data[i]];
+    }
+}
+
+void pixel_blit_c(uint8_t *dst, uint dstStride, const uint8_t *src, uint srcStride, uint width, uint height)
+{
+    for (uint y = 0; y < height; y++)
+    {
+        for (uint x = 0; x < width; x++)
+        {
+            dst[x] = src[x];
+        }
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+#if PICO_NO_HARDWARE
+
+void pixel_lut_apply(uint8_t *data, uint bytes, const uint8_t lut[256])
+{
+    pixel_lut_apply_c(data, bytes, lut);
+}
+
+void pixel_blit(uint8_t *dst, uint dstStride, const uint8_t *src, uint srcStride, uint width, uint height)
+{
+    pixel_blit_c(dst, dstStride, src, srcStride, width, height);
+}
+
+void pixel_kernels_benchmark(void)
+{
+}
+
+#else
+
+// Lane extracting the byte at the given bit position, cross_input lets lane 1 read ACCUM0 as well
+static void lut_lane(interp_hw_t *interp, uint lane, uint shift)
+{
+    interp_config cfg = interp_default_config();
+    interp_config_set_shift(&cfg, shift);
+    interp_config_set_mask(&cfg, 0, 7);
+    interp_config_set_cross_input(&cfg, lane == 1);
+    interp_set_config(interp, lane, &cfg);
+}
+
+void pixel_lut_apply(uint8_t *data, uint bytes, const uint8_t lut[256])
+{
+    interp_hw_save_t save0, save1;
+    interp_save(interp0, &save0);
+    interp_save(interp1, &save1);
+
+    lut_lane(interp0, 0, 0);
+    lut_lane(interp0, 1, 8);
+    lut_lane(interp1, 0, 16);
+    lut_lane(interp1, 1, 24);
+    interp0->base[0] = interp0->base[1] = (uintptr_t)lut;
+    interp1->base[0] = interp1->base[1] = (uintptr_t)lut;
+
+    // Unaligned head and the tail are done byte by byte
+    while (bytes && ((uintptr_t)data & 3))
+    {
+        *data = lut[*data];
+        data++;
+        bytes--;
+    }
+
+    uint32_t *words = (uint32_t *)data;
+    for (uint i = 0; i < bytes / 4; i++)
+    {
+        uint32_t w = words[i];
+        interp0->accum[0] = w;
+        interp1->accum[0] = w;
+        words[i] = *(const uint8_t *)interp0->peek[0]
+                 | *(const uint8_t *)interp0->peek[1] << 8
+                 | *(const uint8_t *)interp1->peek[0] << 16
+                 | (uint32_t)*(const uint8_t *)interp1->peek[1] << 24;
+    }
+
+    data += bytes & ~3u;
+    for (uint i = 0; i < (bytes & 3); i++)
+    {
+        data[i] = lut[data[i]];
+    }
+
+    interp_restore(interp0, &save0);
+    interp_restore(interp1, &save1);
+}
+
+void pixel_blit(uint8_t *dst, uint dstStride, const uint8_t *src, uint srcStride, uint width, uint height)
+{
+    interp_hw_save_t save0;
+    interp_save(interp0, &save0);
+
+    // Both lanes step raw pointers: lane 0 walks the source row, lane 1 the destination row.
+    // POP returns lane 0 and writes both results back to the accumulators.
+    interp_config cfg = interp_default_config();
+    interp_config_set_add_raw(&cfg, true);
+    interp_set_config(interp0, 0, &cfg);
+    interp_set_config(interp0, 1, &cfg);
+    interp0->base[0] = 1;
+    interp0->base[1] = 1;
+
+    for (uint y = 0; y < height; y++)
+    {
+        interp0->accum[0] = (uintptr_t)src;
+        interp0->accum[1] = (uintptr_t)dst;
+        for (uint x = 0; x < width; x++)
+        {
+            uint8_t *d = (uint8_t *)interp0->accum[1];
+            *d = *(const uint8_t *)(interp0->pop[0] - 1);
+        }
+        dst += dstStride;
+        src += srcStride;
+    }
+
+    interp_restore(interp0, &save0);
+}
+
+void pixel_kernels_benchmark(void)
+{
+    static uint8_t frame[1024];
+    static uint8_t screen[1024];
+    uint8_t lut[256];
+    pixel_lut_build(lut, 128, 2.2f);
+
+    for (uint i = 0; i < sizeof(frame); i++)
+    {
+        frame[i] = (uint8_t)i;
+    }
+
+    const uint rounds = 100;
+    uint64_t t0 = time_us_64();
+    for (uint r = 0; r < rounds; r++)
+    {
+        pixel_lut_apply_c(frame, sizeof(frame), lut);
+    }
+    uint64_t t1 = time_us_64();
+    for (uint r = 0; r < rounds; r++)
+    {
+        pixel_lut_apply(frame, sizeof(frame), lut);
+    }
+    uint64_t t2 = time_us_64();
+    printf("LUT %u bytes x %u: C %llu us, interp %llu us\n", (uint)sizeof(frame), rounds, t1 - t0, t2 - t1);
+
+    // OLED sized blit, 128 x 8 pages
+    t0 = time_us_64();
+    for (uint r = 0; r < rounds; r++)
+    {
+        pixel_blit_c(screen, 128, frame, 128, 128, 8);
+    }
+    t1 = time_us_64();
+    for (uint r = 0; r < rounds; r++)
+    {
+        pixel_blit(screen, 128, frame, 128, 128, 8);
+    }
+    t2 = time_us_64();
+    printf("Blit 128x8 x %u: C %llu us, interp %llu us\n", rounds, t1 - t0, t2 - t1);
+}
+
+#endif
@@ -0,0 +1,35 @@
+/* pixel_kernels.h
+ *
+ * Pixel and framebuffer loops running on the RP2040 SIO interpolators of the calling core,
+ * with a plain C fallback for host builds (PICO_NO_HARDWARE).
+ */
+#pragma once
+
+#include <stdint.h>
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Build a 256 entry per-channel table: brightness 0..256 (256 = full), optionally gamma corrected.
+// Entry 0 is always 0, so the table can be applied to unused bytes of a pixel word as well.
+void pixel_lut_build(uint8_t lut[256], uint brightness, float gamma);
+
+// data[i] = lut[data[i]] for every byte, i.e. every color channel of packed or word pixels.
+// WS2812 runs every frame through it when the strip has a table (WS2812::setLut()).
+void pixel_lut_apply(uint8_t *data, uint bytes, const uint8_t lut[256]);
+void pixel_lut_apply_c(uint8_t *data, uint bytes, const uint8_t lut[256]);
+
+// Copy a width x height byte rectangle, rows are dstStride / srcStride bytes apart.
+// pixel_blit() saves and restores interp0 per call, small rectangles (glyphs) are faster with the C loop.
+// The OLED code copies glyphs only, so pixel_blit() has no caller in the firmware besides the benchmark.
+void pixel_blit(uint8_t *dst, uint dstStride, const uint8_t *src, uint srcStride, uint width, uint height);
+void pixel_blit_c(uint8_t *dst, uint dstStride, const uint8_t *src, uint srcStride, uint width, uint height);
+
+// Compare the interpolator kernels with the C loops, results go to stdout
+void pixel_kernels_benchmark(void);
+
+#ifdef __cplusplus
+}
+#endif
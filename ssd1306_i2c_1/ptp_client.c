@@ -0,0 +1,340 @@
+/* ptp_client.c
+ *
+ * All protocol work happens in the lwIP callbacks, including the Delay_Req, so the request
+ * leaves right after the Sync and no main loop latency gets between them. The callbacks keep
+ * the exchange with the shortest path delay, ptp_client_service() hands it to the clock.
+ *
+ * Local timestamps are converted to the uncorrected clock, i.e. minus the corrections applied
+ * until then (clock_discipline_correction_us()). A slew between Sync and Delay_Req then does not
+ * show up as offset, and the stored offsets stay comparable like the NTP samples.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "pico/cyw43_arch.h"
+#include "hardware/sync.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+
+#include "timekeeping.h"
+#include "holdover.h"
+#include "clock_discipline.h"
+#include "ptp_message.h"
+#include "ntp_packet.h"
+#include "ntp_select.h"
+#include "ptp_client.h"
+
+#define PTP_ERROR_US 500            // Software timestamps: interrupt and driver latency
+#define PTP_REQUEST_TIMEOUT_US 1000000
+
+static uint8_t domain;
+static struct udp_pcb *eventPcb;
+static struct udp_pcb *generalPcb;
+static struct pbuf *request;        // Delay_Req, allocated once
+static ip_addr_t group;
+static ptp_port_identity_t self;
+static time_source_t source = { "PTP", NULL, NULL, NULL };
+
+// Master, chosen from the Announce messages
+static bool haveMaster;
+static ptp_message_t master;        // Its last Announce
+static uint64_t masterSeen;
+
+// Exchange in progress, all µs
+static bool syncPending;            // Two-step Sync waiting for its Follow_Up
+static uint16_t syncSequence;
+static int64_t syncCorrection;
+static uint64_t syncTimer;
+static int64_t t1, t2;
+static bool requestPending;
+static uint16_t requestSequence;
+static uint64_t requestTimer;
+static int64_t requestT1, requestT2, t3;
+
+// Best exchange of the window: offset of the uncorrected clock
+static uint32_t windowCount;
+static uint64_t windowStart;
+static int64_t bestOffset;
+static int64_t bestDelay;
+
+// Statistics since the last ptp_client_stats()
+static uint32_t exchanges;
+static uint32_t missed;
+static int64_t offsetSum;
+static uint64_t offsetSquares;
+static uint32_t offsetMax;
+static uint64_t delaySum;
+
+// Local clock at timerUs, without the corrections of the discipline
+static int64_t uncorrected(uint64_t timerUs)
+{
+    return timekeeping_realtime_at(timerUs) - clock_discipline_correction_us(timerUs);
+}
+
+static void count_exchange(int64_t offset, int64_t delay, int64_t correction)
+{
+    // What the clock was off by, clamped so a start-up offset does not overflow the squares
+    int64_t clock = offset - correction;
+    clock = clock > 1000000 ? 1000000 : (clock < -1000000 ? -1000000 : clock);
+    uint32_t magnitude = (uint32_t)(clock < 0 ? -clock : clock);
+
+    exchanges++;
+    offsetSum += clock;
+    offsetSquares += (uint64_t)(clock * clock);
+    offsetMax = magnitude > offsetMax ? magnitude : offsetMax;
+    delaySum += (uint64_t)(delay < 0 ? 0 : delay);
+}
+
+static void send_delay_req(void)
+{
+    uint64_t now = time_us_64();
+    if (requestPending)
+    {
+        if (now - requestTimer < PTP_REQUEST_TIMEOUT_US)
+            return;
+        missed++;
+    }
+
+    // Still queued in the driver
+    if (request->ref > 1)
+        return;
+    pbuf_remove_header(request, request->tot_len - PTP_DELAY_REQ_LEN);
+
+    ptp_message_t m;
+    memset(&m, 0, sizeof(m));
+    m.type = PTP_DELAY_REQ;
+    m.domain = domain;
+    m.source = self;
+    m.sequence = ++requestSequence;
+    m.log_interval = 0x7f;
+    requestT1 = t1;
+    requestT2 = t2;
+
+    // T3 as late as possible, the origin timestamp in the message is only informative
+    requestTimer = time_us_64();
+    t3 = uncorrected(requestTimer);
+    m.timestamp_ns = ptp_from_unix_us(timekeeping_realtime_at(requestTimer), master.utc_offset);
+    ptp_message_encode(&m, (uint8_t *)request->payload);
+    requestPending = udp_sendto(eventPcb, request, &group, PTP_EVENT_PORT) == ERR_OK;
+}
+
+static void on_announce(const ptp_message_t *m, uint64_t received)
+{
+    // Only masters with TAI, an arbitrary timescale says nothing about UTC
+    if (!(m->flags & PTP_FLAG_PTP_TIMESCALE))
+        return;
+
+    bool known = haveMaster && ptp_port_equal(&m->source, &master.source);
+    bool lost = haveMaster && received - masterSeen > PTP_CLIENT_TIMEOUT_MS * 1000ull;
+    if (known || !haveMaster || lost || ptp_announce_compare(m, &master) < 0)
+    {
+        if (!known)
+        {
+            syncPending = false;
+            requestPending = false;
+            windowCount = 0;
+        }
+        master = *m;
+        if (!(m->flags & PTP_FLAG_UTC_OFFSET_VALID))
+        {
+            master.utc_offset = PTP_DEFAULT_UTC_OFFSET;
+        }
+        haveMaster = true;
+        masterSeen = received;
+    }
+}
+
+static void on_sync(const ptp_message_t *m, uint64_t received)
+{
+    syncSequence = m->sequence;
+    syncTimer = received;
+    t2 = uncorrected(received);
+    masterSeen = received;
+
+    if (m->flags & PTP_FLAG_TWO_STEP)
+    {
+        syncCorrection = m->correction_ns;
+        syncPending = true;
+    }
+    else
+    {
+        t1 = ptp_to_unix_us(m->timestamp_ns + m->correction_ns, master.utc_offset);
+        syncPending = false;
+        send_delay_req();
+    }
+}
+
+static void on_follow_up(const ptp_message_t *m)
+{
+    if (!syncPending || m->sequence != syncSequence)
+        return;
+    syncPending = false;
+    t1 = ptp_to_unix_us(m->timestamp_ns + syncCorrection + m->correction_ns, master.utc_offset);
+    send_delay_req();
+}
+
+static void on_delay_resp(const ptp_message_t *m)
+{
+    if (!requestPending || m->sequence != requestSequence || !ptp_port_equal(&m->requesting, &self))
+        return;
+    requestPending = false;
+
+    int64_t t4 = ptp_to_unix_us(m->timestamp_ns - m->correction_ns, master.utc_offset);
+    int64_t offset, delay;
+    ptp_offset(requestT1, requestT2, t3, t4, &offset, &delay);
+    count_exchange(offset, delay, clock_discipline_correction_us(syncTimer));
+
+    if (!windowCount || delay < bestDelay)
+    {
+        bestOffset = offset;
+        bestDelay = delay;
+    }
+    if (!windowCount++)
+    {
+        windowStart = syncTimer;
+    }
+}
+
+static void ptp_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    (void)arg;
+    (void)upcb;
+    (void)addr;
+    (void)port;
+    uint64_t received = time_us_64();   // T2 of a Sync, as early as possible
+
+    uint8_t buf[PTP_MAX_LEN];
+    uint32_t len = pbuf_copy_partial(p, buf, sizeof(buf), 0);
+    pbuf_free(p);
+
+    ptp_message_t m;
+    if (!ptp_message_decode(&m, buf, len) || m.domain != domain)
+        return;
+
+    if (m.type == PTP_ANNOUNCE)
+    {
+        on_announce(&m, received);
+        return;
+    }
+    if (!haveMaster || !ptp_port_equal(&m.source, &master.source))
+        return;
+
+    switch (m.type)
+    {
+    case PTP_SYNC:
+        on_sync(&m, received);
+        break;
+    case PTP_FOLLOW_UP:
+        on_follow_up(&m);
+        break;
+    case PTP_DELAY_RESP:
+        on_delay_resp(&m);
+        break;
+    }
+}
+
+bool ptp_client_init(uint8_t d)
+{
+    domain = d;
+
+    // Clock identity from the MAC address (EUI-48 to EUI-64)
+    uint8_t mac[6];
+    cyw43_wifi_get_mac(&cyw43_state, CYW43_ITF_STA, mac);
+    uint8_t identity[8] = { mac[0], mac[1], mac[2], 0xff, 0xfe, mac[3], mac[4], mac[5] };
+    memcpy(self.clock, identity, 8);
+    self.port = 1;
+
+    request = pbuf_alloc(PBUF_TRANSPORT, PTP_DELAY_REQ_LEN, PBUF_RAM);
+    eventPcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    generalPcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!request || !eventPcb || !generalPcb)
+        return false;
+
+    ipaddr_aton(PTP_PRIMARY_GROUP, &group);
+    if (udp_bind(eventPcb, IP_ANY_TYPE, PTP_EVENT_PORT) != ERR_OK ||
+        udp_bind(generalPcb, IP_ANY_TYPE, PTP_GENERAL_PORT) != ERR_OK ||
+        igmp_joingroup(IP4_ADDR_ANY4, ip_2_ip4(&group)) != ERR_OK)
+    {
+        printf("ptp: can not open ports %u/%u\n", PTP_EVENT_PORT, PTP_GENERAL_PORT);
+        return false;
+    }
+    udp_recv(eventPcb, ptp_recv, NULL);
+    udp_recv(generalPcb, ptp_recv, NULL);
+    return true;
+}
+
+void ptp_client_service(void)
+{
+    if (!eventPcb)
+        return;
+
+    bool locked = time_source_current() == &source;
+    uint32_t irq = save_and_disable_interrupts();
+    uint64_t now = time_us_64();
+    if (haveMaster && now - masterSeen > PTP_CLIENT_TIMEOUT_MS * 1000ull)
+    {
+        haveMaster = false;
+        windowCount = 0;
+    }
+
+    // A poll interval of the discipline once PTP sets the clock, a few exchanges before
+    bool due = windowCount &&
+               (locked ? now - windowStart >= clock_discipline_poll_s() * 1000000ull : windowCount >= PTP_CLIENT_FIRST);
+    int64_t offset = bestOffset;
+    // Asymmetric Wi-Fi may even give a negative mean path delay
+    uint32_t error = (uint32_t)(bestDelay > 0 ? bestDelay : 0) + PTP_ERROR_US;
+    if (due)
+    {
+        windowCount = 0;
+    }
+    restore_interrupts(irq);
+
+    if (!due)
+        return;
+
+    offset -= clock_discipline_correction_us(now);
+    int64_t utcUs = timekeeping_realtime_at(now) + offset;
+
+    bool used = false;
+    if (locked && clock_discipline_offset(offset, now))
+    {
+        used = time_source_confirm(&source, now, error);
+    }
+    else if (time_source_offer(&source, utcUs, now, error))
+    {
+        clock_discipline_step(offset);
+        used = true;
+    }
+
+    if (used)
+    {
+        holdover_sync(utcUs, now);
+    }
+}
+
+time_source_t *ptp_client_time_source(void)
+{
+    return &source;
+}
+
+void ptp_client_stats(ptp_client_stats_t *stats)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    stats->exchanges = exchanges;
+    stats->missed = missed;
+    stats->offset_mean_us = exchanges ? offsetSum / exchanges : 0;
+    stats->offset_rms_us = exchanges ? (uint32_t)sqrt((double)offsetSquares / exchanges) : 0;
+    stats->offset_max_us = offsetMax;
+    stats->delay_mean_us = exchanges ? (uint32_t)(delaySum / exchanges) : 0;
+    stats->master = haveMaster;
+    memcpy(stats->grandmaster, master.grandmaster, 8);
+    exchanges = 0;
+    missed = 0;
+    offsetSum = 0;
+    offsetSquares = 0;
+    offsetMax = 0;
+    delaySum = 0;
+    restore_interrupts(irq);
+}
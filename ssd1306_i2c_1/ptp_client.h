@@ -0,0 +1,54 @@
+/* ptp_client.h
+ *
+ * PTPv2 ordinary clock, slave only, end-to-end delay mechanism over UDP (lwIP raw API).
+ *
+ * The best master is chosen from its Announce messages. Every Sync (with its Follow_Up from a
+ * two-step master) is answered with a Delay_Req, the Delay_Resp completes the exchange. Receive
+ * and transmit times are software timestamps taken in the lwIP callback and right before sending.
+ *
+ * Exchanges come every second or faster, far more often than the clock discipline wants them.
+ * Over one poll interval the exchange with the shortest path delay is kept, the one least
+ * disturbed by Wi-Fi, and handed to the loop like an NTP result. PTP is a time source beside NTP,
+ * the source with the smaller error bound sets the clock.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "time_source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PTP_CLIENT_TIMEOUT_MS 8000      // Master lost without Announce / Sync
+#define PTP_CLIENT_FIRST 8              // Exchanges before the first offset is taken
+
+typedef struct {
+    uint32_t exchanges;                 // Complete Sync / Delay_Req exchanges
+    uint32_t missed;                    // Follow_Up or Delay_Resp never came
+    int64_t offset_mean_us;             // Master - clock
+    uint32_t offset_rms_us;
+    uint32_t offset_max_us;             // Largest magnitude
+    uint32_t delay_mean_us;             // Mean path delay
+    bool master;                        // A master is known
+    uint8_t grandmaster[8];
+} ptp_client_stats_t;
+
+// Joins the PTP group and opens both ports for the domain, call in lwIP context after
+// cyw43_arch_init() and after the Wi-Fi link is up (the MAC gives the clock identity)
+bool ptp_client_init(uint8_t domain);
+
+// Hands the best exchange of a poll interval to the clock. Call from the main loop.
+void ptp_client_service(void);
+
+// Register it with time_source_register()
+time_source_t *ptp_client_time_source(void);
+
+// Offsets and delays since the previous call
+void ptp_client_stats(ptp_client_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
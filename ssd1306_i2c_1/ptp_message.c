@@ -0,0 +1,188 @@
+/* ptp_message.c
+ */
+#include <string.h>
+
+#include "ptp_message.h"
+
+#define PTP_HEADER_LEN 34
+#define PTP_DELAY_RESP_LEN 54
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static uint64_t get64(const uint8_t *p, uint32_t bytes)
+{
+    uint64_t v = 0;
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+static void put64(uint8_t *p, uint64_t v, uint32_t bytes)
+{
+    for (uint32_t i = bytes; i > 0; i--)
+    {
+        p[i - 1] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+// 48 bit seconds and 32 bit nanoseconds
+static int64_t get_timestamp(const uint8_t *p)
+{
+    return (int64_t)get64(p, 6) * 1000000000 + (int64_t)get64(p + 6, 4);
+}
+
+static void put_timestamp(uint8_t *p, int64_t ns)
+{
+    put64(p, (uint64_t)(ns / 1000000000), 6);
+    put64(p + 6, (uint64_t)(ns % 1000000000), 4);
+}
+
+static void get_port(ptp_port_identity_t *port, const uint8_t *p)
+{
+    memcpy(port->clock, p, 8);
+    port->port = get16(p + 8);
+}
+
+static void put_port(uint8_t *p, const ptp_port_identity_t *port)
+{
+    memcpy(p, port->clock, 8);
+    put16(p + 8, port->port);
+}
+
+static uint32_t message_length(uint8_t type)
+{
+    switch (type)
+    {
+    case PTP_SYNC:
+    case PTP_DELAY_REQ:
+    case PTP_FOLLOW_UP:
+        return PTP_DELAY_REQ_LEN;
+    case PTP_DELAY_RESP:
+        return PTP_DELAY_RESP_LEN;
+    case PTP_ANNOUNCE:
+        return PTP_MAX_LEN;
+    default:
+        return 0;
+    }
+}
+
+uint32_t ptp_message_encode(const ptp_message_t *m, uint8_t *buf)
+{
+    uint32_t len = message_length(m->type);
+    memset(buf, 0, len);
+
+    buf[0] = m->type & 0x0f;
+    buf[1] = PTP_VERSION;
+    put16(buf + 2, (uint16_t)len);
+    buf[4] = m->domain;
+    put16(buf + 6, m->flags);
+    put64(buf + 8, (uint64_t)(m->correction_ns * 65536), 8);  // 2^-16 ns
+    put_port(buf + 20, &m->source);
+    put16(buf + 30, m->sequence);
+    buf[32] = m->type == PTP_SYNC ? 0 : m->type == PTP_DELAY_REQ ? 1 : m->type == PTP_FOLLOW_UP ? 2 :
+              m->type == PTP_DELAY_RESP ? 3 : 5;  // controlField of PTPv1 hardware
+    buf[33] = (uint8_t)m->log_interval;
+    put_timestamp(buf + 34, m->timestamp_ns);
+
+    if (m->type == PTP_DELAY_RESP)
+    {
+        put_port(buf + 44, &m->requesting);
+    }
+    else if (m->type == PTP_ANNOUNCE)
+    {
+        put16(buf + 44, (uint16_t)m->utc_offset);
+        buf[47] = m->priority1;
+        buf[48] = m->clock_class;
+        buf[49] = m->clock_accuracy;
+        put16(buf + 50, m->variance);
+        buf[52] = m->priority2;
+        memcpy(buf + 53, m->grandmaster, 8);
+        put16(buf + 61, m->steps_removed);
+    }
+    return len;
+}
+
+bool ptp_message_decode(ptp_message_t *m, const uint8_t *buf, uint32_t len)
+{
+    if (len < PTP_HEADER_LEN || (buf[1] & 0x0f) != PTP_VERSION)
+        return false;
+
+    memset(m, 0, sizeof(*m));
+    m->type = buf[0] & 0x0f;
+    uint32_t need = message_length(m->type);
+    if (!need || len < need || get16(buf + 2) < need)
+        return false;
+
+    m->domain = buf[4];
+    m->flags = get16(buf + 6);
+    m->correction_ns = (int64_t)get64(buf + 8, 8) / 65536;
+    get_port(&m->source, buf + 20);
+    m->sequence = get16(buf + 30);
+    m->log_interval = (int8_t)buf[33];
+    m->timestamp_ns = get_timestamp(buf + 34);
+
+    if (m->type == PTP_DELAY_RESP)
+    {
+        get_port(&m->requesting, buf + 44);
+    }
+    else if (m->type == PTP_ANNOUNCE)
+    {
+        m->utc_offset = (int16_t)get16(buf + 44);
+        m->priority1 = buf[47];
+        m->clock_class = buf[48];
+        m->clock_accuracy = buf[49];
+        m->variance = get16(buf + 50);
+        m->priority2 = buf[52];
+        memcpy(m->grandmaster, buf + 53, 8);
+        m->steps_removed = get16(buf + 61);
+    }
+    return true;
+}
+
+bool ptp_port_equal(const ptp_port_identity_t *a, const ptp_port_identity_t *b)
+{
+    return a->port == b->port && memcmp(a->clock, b->clock, 8) == 0;
+}
+
+int ptp_announce_compare(const ptp_message_t *a, const ptp_message_t *b)
+{
+    if (a->priority1 != b->priority1)
+        return a->priority1 < b->priority1 ? -1 : 1;
+    if (a->clock_class != b->clock_class)
+        return a->clock_class < b->clock_class ? -1 : 1;
+    if (a->clock_accuracy != b->clock_accuracy)
+        return a->clock_accuracy < b->clock_accuracy ? -1 : 1;
+    if (a->variance != b->variance)
+        return a->variance < b->variance ? -1 : 1;
+    if (a->priority2 != b->priority2)
+        return a->priority2 < b->priority2 ? -1 : 1;
+    return memcmp(a->grandmaster, b->grandmaster, 8);
+}
+
+int64_t ptp_to_unix_us(int64_t taiNs, int16_t utcOffset)
+{
+    return taiNs / 1000 - (int64_t)utcOffset * 1000000;
+}
+
+int64_t ptp_from_unix_us(int64_t utcUs, int16_t utcOffset)
+{
+    return (utcUs + (int64_t)utcOffset * 1000000) * 1000;
+}
+
+void ptp_offset(int64_t t1, int64_t t2, int64_t t3, int64_t t4, int64_t *offset, int64_t *delay)
+{
+    *offset = ((t1 - t2) + (t4 - t3)) / 2;
+    *delay = ((t2 - t1) + (t4 - t3)) / 2;
+}
@@ -0,0 +1,88 @@
+/* ptp_message.h
+ *
+ * PTPv2 (IEEE 1588-2008) messages over UDP/IPv4 as an end-to-end ordinary clock sees them:
+ * Announce, Sync, Follow_Up, Delay_Req and Delay_Resp, and the offset / path delay computation.
+ *
+ * PTP timestamps are TAI seconds (48 bits) and nanoseconds, kept here as one int64 of TAI ns,
+ * good until 2262. The master announces the TAI - UTC offset.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PTP_EVENT_PORT 319              // Sync, Delay_Req: timestamped
+#define PTP_GENERAL_PORT 320            // Announce, Follow_Up, Delay_Resp
+#define PTP_PRIMARY_GROUP "224.0.1.129"
+#define PTP_VERSION 2
+#define PTP_DELAY_REQ_LEN 44            // Same for Sync and Follow_Up
+#define PTP_MAX_LEN 64                  // Announce
+
+#define PTP_SYNC 0x0
+#define PTP_DELAY_REQ 0x1
+#define PTP_FOLLOW_UP 0x8
+#define PTP_DELAY_RESP 0x9
+#define PTP_ANNOUNCE 0xb
+
+#define PTP_FLAG_TWO_STEP 0x0200        // Precise origin timestamp follows in a Follow_Up
+#define PTP_FLAG_UTC_OFFSET_VALID 0x0004
+#define PTP_FLAG_PTP_TIMESCALE 0x0008   // TAI, else an arbitrary timescale
+
+#define PTP_DEFAULT_UTC_OFFSET 37       // TAI - UTC since 2017
+
+typedef struct {
+    uint8_t clock[8];                   // EUI-64
+    uint16_t port;
+} ptp_port_identity_t;
+
+typedef struct {
+    uint8_t type;                       // PTP_SYNC, ...
+    uint8_t domain;
+    uint16_t flags;                     // PTP_FLAG_*
+    int64_t correction_ns;              // Residence times of transparent clocks on the way
+    ptp_port_identity_t source;
+    uint16_t sequence;
+    int8_t log_interval;                // log2 s
+
+    // Origin (Sync, Delay_Req), precise origin (Follow_Up) or receive timestamp (Delay_Resp)
+    int64_t timestamp_ns;
+    ptp_port_identity_t requesting;     // Delay_Resp
+
+    // Announce
+    int16_t utc_offset;
+    uint8_t priority1;
+    uint8_t clock_class;
+    uint8_t clock_accuracy;
+    uint16_t variance;
+    uint8_t priority2;
+    uint8_t grandmaster[8];
+    uint16_t steps_removed;
+} ptp_message_t;
+
+// Returns the length written, at most PTP_MAX_LEN
+uint32_t ptp_message_encode(const ptp_message_t *message, uint8_t *buf);
+
+// False for other versions, unknown types and short messages
+bool ptp_message_decode(ptp_message_t *message, const uint8_t *buf, uint32_t len);
+
+bool ptp_port_equal(const ptp_port_identity_t *a, const ptp_port_identity_t *b);
+
+// Best master clock: negative when the master announced by a is better than the one of b.
+// Priority 1, class, accuracy, variance, priority 2 and identity, in this order.
+int ptp_announce_compare(const ptp_message_t *a, const ptp_message_t *b);
+
+// TAI ns to UTC µs and back
+int64_t ptp_to_unix_us(int64_t taiNs, int16_t utcOffset);
+int64_t ptp_from_unix_us(int64_t utcUs, int16_t utcOffset);
+
+// End-to-end delay mechanism: t1 master sends Sync, t2 slave receives it, t3 slave sends
+// Delay_Req, t4 master receives it, all µs. Offset is master - slave, delay the mean path delay.
+void ptp_offset(int64_t t1, int64_t t2, int64_t t3, int64_t t4, int64_t *offset, int64_t *delay);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,136 @@
+/* sntp_server.c
+ *
+ * The reply is written into a pool buffer in place, the transmit timestamp is the last field
+ * filled before udp_sendto(). lwIP pushes the frame to the Wi-Fi driver within the call, the
+ * remaining delay to the air is part of the root dispersion anyway.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+
+#include "timekeeping.h"
+#include "time_source.h"
+#include "ntp_packet.h"
+#include "ntp_client.h"
+#include "sntp_server.h"
+
+#define SNTP_UNSYNCHRONIZED 16
+
+static struct udp_pcb *pcb;
+static struct pbuf *pool[SNTP_SERVER_POOL];
+static sntp_server_stats_t stats;
+
+// Fills reply from request, received (T2) is the time the request came in. The transmit
+// timestamp is taken last. Returns false for anything but a client request.
+static bool build_reply(const uint8_t *request, uint32_t len, int64_t received, uint8_t *reply)
+{
+    if (len < NTP_PACKET_LEN)
+        return false;
+
+    ntp_packet_t in;
+    ntp_packet_decode(&in, request);
+    if (in.mode != NTP_MODE_CLIENT || in.version < 1 || in.version > 4)
+        return false;
+
+    ntp_client_status_t sync;
+    ntp_client_status(&sync);
+    uint32_t error = time_source_error_us();
+
+    ntp_packet_t out;
+    out.leap = sync.synchronized ? 0 : NTP_LEAP_UNSYNCHRONIZED;
+    out.version = in.version;
+    out.mode = NTP_MODE_SERVER;
+    out.stratum = sync.synchronized && sync.stratum < 15 ? sync.stratum + 1 : SNTP_UNSYNCHRONIZED;
+    out.poll = in.poll;
+    out.precision = SNTP_SERVER_PRECISION;
+    out.root_delay = ntp_short_from_us(sync.root_delay_us);
+    out.root_dispersion = error > 0xffff * 1000000u ? 0xffffffffu : ntp_short_from_us(error);
+    out.reference_id = sync.reference_id;
+    out.reference = sync.synchronized ? ntp_timestamp_from_unix_us(sync.reference_us) : 0;
+    out.origin = in.transmit;
+    out.receive = ntp_timestamp_from_unix_us(received);
+    out.transmit = ntp_timestamp_from_unix_us(timekeeping_realtime_us());
+    ntp_packet_encode(&out, reply);
+    return true;
+}
+
+static void count_latency(int64_t received, const uint8_t *reply)
+{
+    ntp_packet_t sent;
+    ntp_packet_decode(&sent, reply);
+    uint32_t latency = (uint32_t)(ntp_timestamp_to_unix_us(sent.transmit, received) - received);
+    stats.replies++;
+    stats.latency_max_us = latency > stats.latency_max_us ? latency : stats.latency_max_us;
+    stats.latency_mean_us = stats.latency_mean_us + ((int32_t)latency - (int32_t)stats.latency_mean_us) / 16;
+}
+
+static struct pbuf *free_buffer(void)
+{
+    for (uint32_t i = 0; i < SNTP_SERVER_POOL; i++)
+    {
+        // Still referenced by lwIP when the reply waits for ARP
+        if (pool[i]->ref == 1)
+        {
+            // udp_sendto() leaves the UDP and IP headers in front of the payload
+            pbuf_remove_header(pool[i], pool[i]->tot_len - NTP_PACKET_LEN);
+            return pool[i];
+        }
+    }
+    return NULL;
+}
+
+static void sntp_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    (void)arg;
+    int64_t received = timekeeping_realtime_us();  // T2, as early as possible
+    stats.requests++;
+
+    uint8_t request[NTP_PACKET_LEN];
+    uint32_t len = pbuf_copy_partial(p, request, NTP_PACKET_LEN, 0);
+    pbuf_free(p);
+
+    struct pbuf *reply = free_buffer();
+    if (!reply)
+    {
+        stats.dropped++;
+        return;
+    }
+
+    if (build_reply(request, len, received, (uint8_t *)reply->payload))
+    {
+        udp_sendto(upcb, reply, addr, port);
+        count_latency(received, (const uint8_t *)reply->payload + (reply->tot_len - NTP_PACKET_LEN));
+    }
+}
+
+bool sntp_server_init(void)
+{
+    for (uint32_t i = 0; i < SNTP_SERVER_POOL; i++)
+    {
+        pool[i] = pbuf_alloc(PBUF_TRANSPORT, NTP_PACKET_LEN, PBUF_RAM);
+        if (!pool[i])
+        {
+            printf("sntp server: failed to allocate buffers\n");
+            return false;
+        }
+    }
+
+    pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb || udp_bind(pcb, IP_ANY_TYPE, NTP_PORT) != ERR_OK)
+    {
+        printf("sntp server: port %u not available\n", NTP_PORT);
+        return false;
+    }
+    udp_recv(pcb, sntp_recv, NULL);
+    return true;
+}
+
+void sntp_server_stats(sntp_server_stats_t *s)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    *s = stats;
+    restore_interrupts(irq);
+}
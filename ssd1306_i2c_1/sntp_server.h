@@ -0,0 +1,41 @@
+/* sntp_server.h
+ *
+ * SNTP server (RFC 4330) on UDP port 123, passes the disciplined clock on to the other devices
+ * in the LAN.
+ *
+ * Receive and transmit timestamps are taken in the udp_recv callback, right when the request
+ * arrives and right before the reply goes to the driver. Stratum, reference ID and root delay
+ * come from the NTP client, the root dispersion is the error bound of the clock. While the clock
+ * does not follow NTP the replies say so (leap indicator 3, stratum 16).
+ *
+ * Replies are built in a fixed pool of pbufs allocated at startup, a burst of requests never
+ * allocates memory. Requests arriving while all buffers are still queued are dropped.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNTP_SERVER_POOL 8          // Replies in flight
+#define SNTP_SERVER_PRECISION -20   // log2 s, the µs timer
+
+typedef struct {
+    uint32_t requests;
+    uint32_t replies;
+    uint32_t dropped;               // No free buffer
+    uint32_t latency_max_us;        // Receive to transmit timestamp
+    uint32_t latency_mean_us;       // Exponential average
+} sntp_server_stats_t;
+
+// Binds UDP port 123 and allocates the pool, call in lwIP context after cyw43_arch_init()
+bool sntp_server_init(void);
+
+void sntp_server_stats(sntp_server_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
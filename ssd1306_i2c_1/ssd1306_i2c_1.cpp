@@ -30,36 +30,60 @@
 #include "pico/cyw43_arch.h"
 #include "sd_card.h"
 #include "ff.h"
+#include "pixel_kernels.h"
 
 /**
- * NTP Stuff, code borrowed from pico_examles/pico_w/ntp
+ * NTP Stuff, several servers queried at once, see ntp_client.c
  * 
  */
-#include "lwip/dns.h"
-#include "lwip/pbuf.h"
-#include "lwip/udp.h"
-
-typedef struct NTP_T_ {
-    ip_addr_t ntp_server_address;
-    bool dns_request_sent;
-    struct udp_pcb *ntp_pcb;
-    absolute_time_t ntp_test_time;
-    alarm_id_t ntp_resend_alarm;
-} NTP_T;
-
-#define NTP_SERVER "pool.ntp.org"
-#define NTP_MSG_LEN 48
-#define NTP_PORT 123
-#define NTP_DELTA 2208988800 // seconds between 1 Jan 1900 and 1 Jan 1970
-#define NTP_TEST_TIME (30 * 1000)
-#define NTP_RESEND_TIME (10 * 1000)
-
-time_t epoch = 0;
+#include "ntp_client.h"
+#include "sntp_server.h"
+#include "dns_cache.h"
+#include "time_beacon.h"
+#include "ptp_client.h"
+
+// Pool members, optionally preceded by a server in the local network (-DNTP_LOCAL_SERVER=\"192.168.1.1\")
+static const char *ntpServers[] = {
+#ifdef NTP_LOCAL_SERVER
+    NTP_LOCAL_SERVER,
+#endif
+    "0.pool.ntp.org",
+    "1.pool.ntp.org",
+    "2.pool.ntp.org",
+    "3.pool.ntp.org"
+};
+
+// Several clocks in one room: one master polls NTP and multicasts the time, the others follow it
+// (-DTIME_BEACON_ROLE=TIME_BEACON_MASTER or TIME_BEACON_FOLLOWER)
+#ifndef TIME_BEACON_ROLE
+#define TIME_BEACON_ROLE TIME_BEACON_OFF
+#endif
+
+// PTP grandmaster in the network, its domain (-DPTP_DOMAIN=0). PTP and NTP run side by side.
+//#define PTP_DOMAIN 0
+
+#include "timekeeping.h"
+#include "tick_scheduler.h"
+#include "holdover.h"
+#include "clock_discipline.h"
+#include "time_source.h"
+#include "ds3231.h"
+#include "warm_restart.h"
+#include "drift_file.h"
+#include "hardware/watchdog.h"
 
 #include "pico/critical_section.h"
 critical_section_t myLock;
 
-#define BUTTON_DST 12 // Switch time to DST
+#include "civil_time.h"
+#include "time_zone.h"
+
+// Local time zone as POSIX TZ rule, CMakeLists.txt sets the default. May be overridden by wifi.txt.
+#ifndef TZ_RULE
+#define TZ_RULE "CET-1CEST,M3.5.0,M10.5.0/3"
+#endif
+char tzRule[48] = TZ_RULE;
+time_zone_t localZone;
 
 
 /**
@@ -147,32 +171,47 @@ uint8_t buf[SSD1306_BUF_LEN];
  */
 
 #include "WS2812.hpp"
+#include "LedOutputs.hpp"
 
 #define LED_PIN85 14    // Outer ring
 #define LED_PIN65 15    // Inner ring
 #define LED_LENGTH 24   // LEDs count
 
-// Some constants for NeoPixel rings
-#define RED_HIGH 64     // High red color intensity
-#define RED_LOW1 1     // Low1 red color intensity
-#define RED_LOW2 2     // Low2 red color intensity
+// LED strips, another ring is just another entry. Pixel format used by the rings was: FORMAT_GRB FORMAT_RGB
+static const LedOutputs::Config ledConfig[] = {
+    { LED_PIN85, LED_LENGTH, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED },  // Outer ring (GP14)
+    { LED_PIN65, LED_LENGTH, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED },  // Inner ring (GP15)
+};
+
+LedOutputs leds(ledConfig, count_of(ledConfig));
+
+// Ring geometry, hand colors and intensities are described in ClockFace.cpp
+#include "ClockFace.hpp"
+static_assert(LED_LENGTH == ClockFace::RING_LEDS, "Clock face frames are generated for the ring size");
 
-#define BLUE_HIGH 64    // High blue color intensity
-#define BLUE_LOW1 1     // Low1 blue color intensity
-#define BLUE_LOW2 2     // Low2 blue color intensity
-#define BLUE_LOW3 15    // Low3 blue color intensity
-#define BLUE_LOW4 20    // Low4 blue color intensity
+// Layers of each ring: the face from ClockFace at the bottom, the second hand and effects over it
+#include "Compositor.hpp"
+Compositor face85(LED_LENGTH);
+Compositor face65(LED_LENGTH);
 
+// Sweeping second hand on the outer ring, redrawn up to SECOND_HAND_FPS times a second. 0 disables it.
+// The rings are only pushed when the hand lights the LEDs differently.
+#include "HandRenderer.hpp"
+#define SECOND_HAND_FPS 0
+#define SECOND_HAND_COLOR WS2812::RGB(16, 8, 0)
 
+// Angle table generated at compile time, in flash
+static constexpr HandRenderer secondHand(ClockFace::OUTER_RING);
 
-#define STRIP65_SHIFT 3 // Because Inner ring is mounted 3 LEDs shifted against Outer ring due mounting holes shift
+// Main loop runs at least once per second, the time is saved on every tick. The watchdog timeout
+// (WATCHDOG_TIMEOUT_MS) is in warm_restart.h, it bounds the time lost before a reset.
 
 // Forward declarations
-void clear(WS2812 ledStrip);
-void setDateTime(WS2812 ledStrip85, WS2812 ledStrip65, uint hours, uint minutes);
-void test1(WS2812 ledStrip85, WS2812 ledStrip65);
-void test2(WS2812 ledStrip85, WS2812 ledStrip65);
-void test3(WS2812 ledStrip85, WS2812 ledStrip65);
+void clear(WS2812 &ledStrip);
+void setDateTime(WS2812 &ledStrip85, WS2812 &ledStrip65, uint hours, uint minutes, int secondHandAngle = -1);
+void test1(WS2812 &ledStrip85, WS2812 &ledStrip65);
+void test2(WS2812 &ledStrip85, WS2812 &ledStrip65);
+void test3(WS2812 &ledStrip85, WS2812 &ledStrip65);
 
 //===========================================================================================
 void calc_render_area_buflen(struct render_area *area) 
@@ -397,10 +436,8 @@ static void WriteChar(uint8_t *buf, int16_t x, int16_t y, uint8_t ch)
     int idx = GetFontIndex(ch);
     int fb_idx = y * 128 + x;
 
-    for (int i=0;i<8;i++) 
-    {
-        buf[fb_idx++] = reversed[idx * 8 + i];
-    }
+    // One 8x8 glyph is 8 consecutive column bytes in one page, too small to pay for saving the interpolator
+    pixel_blit_c(&buf[fb_idx], SSD1306_WIDTH, &reversed[idx * 8], 8, 8, 1);
 }
 
 static void WriteString(uint8_t *buf, int16_t x, int16_t y, const char *str)
@@ -416,11 +453,63 @@ static void WriteString(uint8_t *buf, int16_t x, int16_t y, const char *str)
     }
 }
 
-void displayTime(struct tm *utc, WS2812 ledStrip85, WS2812 ledStrip65)
+/**
+ * Sends only the columns that changed since the last call, one area per page.
+ * A new second is two glyphs, about 0.5 ms on the bus instead of 23 ms for the whole frame.
+ */
+void renderChanges(uint8_t *buf)
 {
-    // zero the entire display
+    static uint8_t shown[SSD1306_BUF_LEN];
+    static bool valid = false;
+
+    for (uint page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        const uint8_t *now = &buf[page * SSD1306_WIDTH];
+        uint8_t *was = &shown[page * SSD1306_WIDTH];
+        int first = 0;
+        int last = SSD1306_WIDTH - 1;
+
+        if (valid)
+        {
+            while (first < SSD1306_WIDTH && now[first] == was[first])
+                first++;
+            if (first == SSD1306_WIDTH)
+                continue;
+            while (now[last] == was[last])
+                last--;
+        }
+
+        struct render_area area = {
+            start_col : (uint8_t)first,
+            end_col : (uint8_t)last,
+            start_page : (uint8_t)page,
+            end_page : (uint8_t)page
+        };
+        calc_render_area_buflen(&area);
+        render((uint8_t *)&now[first], &area);
+        memcpy(&was[first], &now[first], last - first + 1);
+    }
+    valid = true;
+}
+
+// Local hours and minutes of the screen in buf, the rings show them together with it
+uint drawnHours, drawnMinutes, drawnSeconds;
+
+// What the rings show since the last tick, the second hand sweeps over it
+uint shownHours, shownMinutes;
+
+/**
+ * Draws the screen for the given UTC second into buf, without sending it
+ */
+void drawTime(time_t now)
+{
+    civil_time_t utc, local;
+    bool isDST;
+
+    civil_from_unix(now, &utc);
+    civil_from_unix(now + time_zone_offset(&localZone, now, &isDST), &local);
+
     memset(buf, 0, SSD1306_BUF_LEN);
-    render(buf, &frame_area);
 
     char buffer[20];
     int y = 0;
@@ -431,13 +520,13 @@ void displayTime(struct tm *utc, WS2812 ledStrip85, WS2812 ledStrip65)
         WriteString(buf, 5, y, buffer);
         y+=8;
 
-        sprintf(buffer, "%02d/%02d/%04d", utc->tm_mday, utc->tm_mon + 1, utc->tm_year + 1900);
+        sprintf(buffer, "%02d/%02d/%04d", utc.day, utc.month, (int)utc.year);
         WriteString(buf, 5, y, buffer);
         y+=8;
         
         //----------------------------------------------------------------------------------------
         // UTC Time
-        sprintf(buffer, "%02d:%02d:%02d", utc->tm_hour, utc->tm_min, utc->tm_sec);
+        sprintf(buffer, "%02d:%02d:%02d", utc.hour, utc.minute, utc.second);
         WriteString(buf, 5, y, buffer);
         y+=8;
 
@@ -446,269 +535,77 @@ void displayTime(struct tm *utc, WS2812 ledStrip85, WS2812 ledStrip65)
         y+=8;
         
         //----------------------------------------------------------------------------------------
-        // Convert UTC to Local time. Adjust this code with regards of Your location.
-
-        uint maxDayInAnyMonth[13] = { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
-        if(utc->tm_year %4 == 0) { maxDayInAnyMonth[2] = 29; } //adjust for leapyear
-        uint maxDayUtcMth = maxDayInAnyMonth[utc->tm_mon];
-        uint maxDayPrevMth = maxDayInAnyMonth[utc->tm_mon-1];
-        if(!maxDayPrevMth) { maxDayPrevMth = 31; } //month before utc month
-        
-        int localHour = utc->tm_hour;
-        int localDay = utc->tm_mday;
-        int localMonth = utc->tm_mon + 1;
-        int localYear = utc->tm_year;
-
-        if (++localHour > 23) // UTC+1 = CET
-        {
-            localHour = 0;
-
-            if (++localDay > maxDayInAnyMonth[maxDayUtcMth])
-            {
-                localDay = 1;
-
-                if (++localMonth > 12)
-                {
-                    localMonth = 1;
-                    localYear++;
-                }
-            }
-        }
-
-        bool isDST = gpio_get(BUTTON_DST);
-
-        if (isDST)
-        {
-            if (++localHour > 23) // UTC+2 = CEST
-            {
-                localHour = 0;
-
-                if (++localDay > maxDayInAnyMonth[maxDayUtcMth])
-                {
-                    localDay = 1;
-
-                    if (++localMonth > 12)
-                    {
-                        localMonth = 1;
-                        localYear++;
-                    }
-                }
-            }
-        }
-        
-        //----------------------------------------------------------------------------------------
-        // LocalDate
-        if (isDST)
-        {
-            sprintf(buffer, "Date Time CEST");
-        }
-        else
-        {
-            sprintf(buffer, "Date Time CET");
-        } 
+        // LocalDate, zone and DST come from the TZ rule (see tzRule)
+        snprintf(buffer, sizeof(buffer), "Date Time %s", time_zone_name(&localZone, isDST));
         WriteString(buf, 5, y, buffer);
         y+=8;
 
-        sprintf(buffer, "%02d/%02d/%04d", localDay, localMonth, localYear + 1900);
+        sprintf(buffer, "%02d/%02d/%04d", local.day, local.month, (int)local.year);
         WriteString(buf, 5, y, buffer);
         y+=8;
 
         //----------------------------------------------------------------------------------------
         // Local Time      
         
-        sprintf(buffer, "%02d:%02d:%02d", localHour, utc->tm_min, utc->tm_sec);
+        sprintf(buffer, "%02d:%02d:%02d", local.hour, local.minute, local.second);
         WriteString(buf, 5, y, buffer);
         y+=8;
 
         sprintf(buffer, "          ");
         WriteString(buf, 5, y, buffer);
 
-        render(buf, &frame_area);
-
-    //----------------------------------------------------------------------------------------
-    // Neopixels
-    setDateTime(ledStrip85, ledStrip65, localHour, utc->tm_min);
+    drawnHours = local.hour;
+    drawnMinutes = local.minute;
+    drawnSeconds = local.second;
 }
 
-#endif
-
 /**
- * NTP stuff, code borrowed from pico_examples/pico_w/ntp_client
- * 
+ * Shows the screen drawn by drawTime() on the OLED and the rings
  */
-
-// Called with results of operation
-static void ntp_result(NTP_T* state, int status, time_t *result) 
-{
-    if (status == 0 && result) 
-    {
-        struct tm *utc = gmtime(result);
-        printf("got ntp response: %02d/%02d/%04d %02d:%02d:%02d\n", utc->tm_mday, utc->tm_mon + 1, utc->tm_year + 1900,
-               utc->tm_hour, utc->tm_min, utc->tm_sec);
-    }
-
-    if (state->ntp_resend_alarm > 0) 
-    {
-        cancel_alarm(state->ntp_resend_alarm);
-        state->ntp_resend_alarm = 0;
-    }
-    
-    state->ntp_test_time = make_timeout_time_ms(NTP_TEST_TIME);
-    state->dns_request_sent = false;
-}
-
-static int64_t ntp_failed_handler(alarm_id_t id, void *user_data);
-
-// Make an NTP request
-static void ntp_request(NTP_T *state) 
+void displayTime(WS2812 &ledStrip85, WS2812 &ledStrip65)
 {
-    // cyw43_arch_lwip_begin/end should be used around calls into lwIP to ensure correct locking.
-    // You can omit them if you are in a callback from lwIP. Note that when using pico_cyw_arch_poll
-    // these calls are a no-op and can be omitted, but it is a good practice to use them in
-    // case you switch the cyw43_arch type later.
-    cyw43_arch_lwip_begin();
-    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, NTP_MSG_LEN, PBUF_RAM);
-    uint8_t *req = (uint8_t *) p->payload;
-    memset(req, 0, NTP_MSG_LEN);
-    req[0] = 0x1b;
-    udp_sendto(state->ntp_pcb, p, &state->ntp_server_address, NTP_PORT);
-    pbuf_free(p);
-    cyw43_arch_lwip_end();
-}
+    renderChanges(buf);
 
-static int64_t ntp_failed_handler(alarm_id_t id, void *user_data)
-{
-    NTP_T* state = (NTP_T*)user_data;
-    printf("ntp request failed\n");
-    ntp_result(state, -1, NULL);
-    return 0;
-}
-
-// Call back with a DNS result
-static void ntp_dns_found(const char *hostname, const ip_addr_t *ipaddr, void *arg) {
-    NTP_T *state = (NTP_T*)arg;
-    if (ipaddr) 
-    {
-        state->ntp_server_address = *ipaddr;
-        printf("ntp address %s\n", ipaddr_ntoa(ipaddr));
-        ntp_request(state);
-    } 
-    else 
-    {
-        printf("ntp dns request failed\n");
-        ntp_result(state, -1, NULL);
-    }
+    //----------------------------------------------------------------------------------------
+    // Neopixels
+    shownHours = drawnHours;
+    shownMinutes = drawnMinutes;
+    setDateTime(ledStrip85, ledStrip65, drawnHours, drawnMinutes,
+                SECOND_HAND_FPS ? RingGeometry::angle(drawnSeconds, 60) : -1);
 }
 
-// NTP data received
-static void ntp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) 
+/**
+ * Redraws the rings with the second hand at the current sub-second position
+ */
+void sweepSecondHand(WS2812 &ledStrip85, WS2812 &ledStrip65)
 {
-    NTP_T *state = (NTP_T*)arg;
-    uint8_t mode = pbuf_get_at(p, 0) & 0x7;
-    uint8_t stratum = pbuf_get_at(p, 1);
-
-    // Check the result
-    if (ip_addr_cmp(addr, &state->ntp_server_address) && port == NTP_PORT && p->tot_len == NTP_MSG_LEN && mode == 0x4 && stratum != 0) 
-    {
-        uint8_t seconds_buf[4] = {0};
-        pbuf_copy_partial(p, seconds_buf, sizeof(seconds_buf), 40);
-        uint32_t seconds_since_1900 = seconds_buf[0] << 24 | seconds_buf[1] << 16 | seconds_buf[2] << 8 | seconds_buf[3];
-        uint32_t seconds_since_1970 = seconds_since_1900 - NTP_DELTA;
-        
-        // Global var.
-        epoch = seconds_since_1970;
-        ntp_result(state, 0, &epoch);
-    } 
-    else 
-    {
-        printf("invalid ntp response\n");
-        ntp_result(state, -1, NULL);
-    }
-    pbuf_free(p);
-}
+    uint32_t msInMinute = (uint32_t)((timekeeping_realtime_us() / 1000) % 60000);
+    uint16_t angle = RingGeometry::angle(msInMinute, 60000);
 
-// Perform initialisation
-static NTP_T* ntp_init(void) 
-{
-    NTP_T *state = (NTP_T*) calloc(1, sizeof(NTP_T));
-    if (!state) 
+    // About 17 table steps a second, most redraws would show the same LEDs
+    static const HandRenderer::Spread *shown = nullptr;
+    const HandRenderer::Spread *spread = &secondHand.spread(angle);
+    if (spread == shown)
     {
-        printf("failed to allocate state\n");
-        return NULL;
-    }
-    
-    state->ntp_pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
-    if (!state->ntp_pcb) 
-    {
-        printf("failed to create pcb\n");
-        free(state);
-        return NULL;
+        return;
     }
-
-    udp_recv(state->ntp_pcb, ntp_recv, state);
-    return state;
+    shown = spread;
+    setDateTime(ledStrip85, ledStrip65, shownHours, shownMinutes, angle);
 }
 
-// Runs ntp test forever
-void run_ntp_test(NTP_T *state) 
-{
-    if (!state)
-        return;
-
-    while(true) 
-    {
-        if (absolute_time_diff_us(get_absolute_time(), state->ntp_test_time) < 0 && !state->dns_request_sent) 
-        {
-            // Set alarm in case udp requests are lost
-            state->ntp_resend_alarm = add_alarm_in_ms(NTP_RESEND_TIME, ntp_failed_handler, state, true);
-
-            // cyw43_arch_lwip_begin/end should be used around calls into lwIP to ensure correct locking.
-            // You can omit them if you are in a callback from lwIP. Note that when using pico_cyw_arch_poll
-            // these calls are a no-op and can be omitted, but it is a good practice to use them in
-            // case you switch the cyw43_arch type later.
-            cyw43_arch_lwip_begin();
-            int err = dns_gethostbyname(NTP_SERVER, &state->ntp_server_address, ntp_dns_found, state);
-            cyw43_arch_lwip_end();
-
-            state->dns_request_sent = true;
-            if (err == ERR_OK) 
-            {
-                ntp_request(state); // Cached result
-                return;
-            } 
-            else if (err != ERR_INPROGRESS) 
-            {   // ERR_INPROGRESS means expect a callback
-                printf("dns request failed\n");
-                ntp_result(state, -1, NULL);
-            }
-        }
-#if PICO_CYW43_ARCH_POLL 
-        // if you are using pico_cyw43_arch_poll, then you must poll periodically from your
-        // main loop (not from a timer interrupt) to check for Wi-Fi driver or lwIP work that needs to be done.
-        cyw43_arch_poll();
-        // you can poll as often as you like, however if you have nothing else to do you can
-        // choose to sleep until either a specified time, or cyw43_arch_poll() has work to do:
-        cyw43_arch_wait_for_work_until(state->dns_request_sent ? at_the_end_of_time : state->ntp_test_time);
-#else
-        // if you are not using pico_cyw43_arch_poll, then WiFI driver and lwIP work
-        // is done via interrupt in the background. This sleep is just an example of some (blocking)
-        // work you might be doing.
-        sleep_ms(500);
 #endif
-    }
-}
 
 /**
  * Clear given strip 
  */
-void clear(WS2812 ledStrip)
+void clear(WS2812 &ledStrip)
 {
-    ledStrip.fill(0, 0, LED_LENGTH);
+    ledStrip.clear();
     ledStrip.show();
 }
 
     
-void setDateTime(WS2812 ledStrip85, WS2812 ledStrip65, uint hours, uint minutes)
+void setDateTime(WS2812 &ledStrip85, WS2812 &ledStrip65, uint hours, uint minutes, int secondHandAngle)
 {
     if (hours >= 12)
     {
@@ -717,431 +614,28 @@ void setDateTime(WS2812 ledStrip85, WS2812 ledStrip65, uint hours, uint minutes)
 
     critical_section_enter_blocking (&myLock);
 
-    clear(ledStrip85);
-    clear(ledStrip65);
+    // Complete ring pictures are generated at compile time into flash, see ClockFace.cpp.
+    // They are the bottom layer of each ring, the second hand is added over the outer one.
+    face85.setFrame(Compositor::LAYER_TICKS, ClockFace::outer(minutes));
+    face65.setFrame(Compositor::LAYER_TICKS, ClockFace::inner(hours, minutes));
 
-    ledStrip85.fill(0, 0, LED_LENGTH);
-    ledStrip65.fill(0, 0, LED_LENGTH);
-
-    uint minutesShift = 0;
-    if (minutes > 30)
+    face85.setBlendMode(Compositor::LAYER_SECONDS, Compositor::BLEND_ADD);
+    face85.clearLayer(Compositor::LAYER_SECONDS);
+    if (secondHandAngle >= 0)
     {
-        minutesShift = 1;
+        secondHand.draw(face85, Compositor::LAYER_SECONDS, (uint16_t)secondHandAngle, SECOND_HAND_COLOR);
     }
 
-    // Green ticks
-    ledStrip85.setPixelColor(18, 0, 20, 0);
-    ledStrip85.setPixelColor(0, 0, 20, 0);
-    ledStrip85.setPixelColor(6, 0, 20, 0);
-    ledStrip85.setPixelColor(12, 0, 20, 0);
-
-    ledStrip65.setPixelColor(18 - STRIP65_SHIFT, 0, 20, 0);
-    ledStrip65.setPixelColor(24 - STRIP65_SHIFT, 0, 20, 0);
-    ledStrip65.setPixelColor(6 - STRIP65_SHIFT, 0, 20, 0);
-    ledStrip65.setPixelColor(12 - STRIP65_SHIFT, 0, 20, 0);
-
-    int index65;
+    face85.compose(ledStrip85);
+    face65.compose(ledStrip65);
 
-    switch (hours)
-    {
-        case 0:
-            index65 = 18 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 1:
-            index65 = 20 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 2:
-            index65 = 22 + minutesShift - STRIP65_SHIFT, RED_HIGH;
-            break;
-
-        case 3:
-            index65 = 24 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 4:
-            index65 = 26 + minutesShift - STRIP65_SHIFT;
-            if (index65 > 23) { index65 = 0; }
-            break;
-
-        case 5:
-            index65 = 4 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 6:
-            index65 = 6 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 7:
-            index65 = 8 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 8:
-            index65 = 10 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 9:
-            index65 = 12 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 10:
-            index65 = 14 + minutesShift - STRIP65_SHIFT;
-            break;
-
-        case 11:
-            index65 = 16 + minutesShift - STRIP65_SHIFT;
-            break;
-    }
-
-    ledStrip65.setPixelColor(index65, RED_HIGH, 0, 0);
-    printf("ledStrip65: %02d RED_HIGH", index65);
-
-    if ((minutes > 1) && (minutes < 15))
-    {
-        ledStrip65.setPixelColor(index65+1, RED_LOW1, 0, 0);
-        printf("ledStrip65: %02d RED_LOW1", index65+1);
-    }
-    else if ((minutes > 15) && (minutes < 30))
-    {
-        ledStrip65.setPixelColor(index65+1, RED_LOW2, 0, 0);
-        printf("ledStrip65: %02d RED_LOW2", index65);
-    }
-    else if ((minutes > 30) && (minutes < 45))
-    {
-        ledStrip65.setPixelColor(index65+1, RED_LOW1, 0, 0);
-        printf("ledStrip65: %02d RED_LOW1", index65);
-    }
-    else if ((minutes > 45) && (minutes <= 59))
-    {
-        ledStrip65.setPixelColor(index65+1, RED_LOW2, 0, 0);
-        printf("ledStrip65: %02d RED_LOW2", index65);
-    }
-
-    switch (minutes)
-    {
-        case 0:
-            ledStrip85.setPixelColor(18, 0, 0, BLUE_HIGH);
-            break;
-
-        case 1:
-            ledStrip85.setPixelColor(18, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(19, 0, 0, BLUE_LOW1);
-            break;
-
-        case 2:
-            ledStrip85.setPixelColor(18, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(19, 0, 0, BLUE_LOW2);
-            break;
-
-        case 3:
-            ledStrip85.setPixelColor(18, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(19, 0, 0, BLUE_LOW3);
-            break;
-
-        case 4:
-            ledStrip85.setPixelColor(18, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(19, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-        
-        case 5:
-            ledStrip85.setPixelColor(20, 0, 0, BLUE_HIGH);
-            break;
-
-        case 6:
-            ledStrip85.setPixelColor(20, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(21, 0, 0, BLUE_LOW1);
-            break;
-
-        case 7:
-            ledStrip85.setPixelColor(20, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(21, 0, 0, BLUE_LOW2);
-            break;
-
-        case 8:
-            ledStrip85.setPixelColor(20, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(21, 0, 0, BLUE_LOW3);
-            break;
-
-        case 9:
-            ledStrip85.setPixelColor(20, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(21, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-
-        case 10:
-            ledStrip85.setPixelColor(22, 0, 0, BLUE_HIGH);
-            break;
-
-        case 11:
-            ledStrip85.setPixelColor(22, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(23, 0, 0, BLUE_LOW1);
-            break;
-
-        case 12:
-            ledStrip85.setPixelColor(22, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(23, 0, 0, BLUE_LOW2);
-            break;
-
-        case 13:
-            ledStrip85.setPixelColor(22, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(23, 0, 0, BLUE_LOW3);
-            break;
-
-        case 14:
-            ledStrip85.setPixelColor(22, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(23, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-        //-------------------------------------------------------------------------------------
-
-        case 15:
-            ledStrip85.setPixelColor(0, 0, 0, BLUE_HIGH);
-            break;
-
-        case 16:
-            ledStrip85.setPixelColor(0, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(1, 0, 0, BLUE_LOW1);
-            break;
-
-        case 17:
-            ledStrip85.setPixelColor(0, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(1, 0, 0, BLUE_LOW2);
-            break;
-
-        case 18:
-            ledStrip85.setPixelColor(0, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(1, 0, 0, BLUE_LOW3);
-            break;
-
-        case 19:
-            ledStrip85.setPixelColor(0, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(1, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-        
-        case 20:
-            ledStrip85.setPixelColor(2, 0, 0, BLUE_HIGH);
-            break;
-
-        case 21:
-            ledStrip85.setPixelColor(2, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(3, 0, 0, BLUE_LOW1);
-            break;
-
-        case 22:
-            ledStrip85.setPixelColor(2, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(3, 0, 0, BLUE_LOW2);
-            break;
-
-        case 23:
-            ledStrip85.setPixelColor(2, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(3, 0, 0, BLUE_LOW3);
-            break;
-
-        case 24:
-            ledStrip85.setPixelColor(2, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(3, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-
-        case 25:
-            ledStrip85.setPixelColor(4, 0, 0, BLUE_HIGH);
-            break;
-
-        case 26:
-            ledStrip85.setPixelColor(4, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(5, 0, 0, BLUE_LOW1);
-            break;
-
-        case 27:
-            ledStrip85.setPixelColor(4, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(5, 0, 0, BLUE_LOW2);
-            break;
-
-        case 28:
-            ledStrip85.setPixelColor(4, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(5, 0, 0, BLUE_LOW3);
-            break;
-
-        case 29:
-            ledStrip85.setPixelColor(4, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(5, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-        //-------------------------------------------------------------------------------------
-        //-------------------------------------------------------------------------------------
-
-        case 30:
-            ledStrip85.setPixelColor(6, 0, 0, BLUE_HIGH);
-            break;
-
-        case 31:
-            ledStrip85.setPixelColor(6, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(7, 0, 0, BLUE_LOW1);
-            break;
-
-        case 32:
-            ledStrip85.setPixelColor(6, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(7, 0, 0, BLUE_LOW2);
-            break;
-
-        case 33:
-            ledStrip85.setPixelColor(6, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(7, 0, 0, BLUE_LOW3);
-            break;
-
-        case 34:
-            ledStrip85.setPixelColor(6, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(7, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-        
-        case 35:
-            ledStrip85.setPixelColor(8, 0, 0, BLUE_HIGH);
-            break;
-
-        case 36:
-            ledStrip85.setPixelColor(8, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(9, 0, 0, BLUE_LOW1);
-            break;
-
-        case 37:
-            ledStrip85.setPixelColor(8, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(9, 0, 0, BLUE_LOW2);
-            break;
-
-        case 38:
-            ledStrip85.setPixelColor(8, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(9, 0, 0, BLUE_LOW3);
-            break;
-
-        case 39:
-            ledStrip85.setPixelColor(8, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(9, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-
-        case 40:
-            ledStrip85.setPixelColor(10, 0, 0, BLUE_HIGH);
-            break;
-
-        case 41:
-            ledStrip85.setPixelColor(10, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(11, 0, 0, BLUE_LOW1);
-            break;
-
-        case 42:
-            ledStrip85.setPixelColor(10, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(11, 0, 0, BLUE_LOW2);
-            break;
-
-        case 43:
-            ledStrip85.setPixelColor(10, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(11, 0, 0, BLUE_LOW3);
-            break;
-
-        case 44:
-            ledStrip85.setPixelColor(10, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(11, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-        //-------------------------------------------------------------------------------------
-
-        case 45:
-            ledStrip85.setPixelColor(12, 0, 0, BLUE_HIGH);
-            break;
-
-        case 46:
-            ledStrip85.setPixelColor(12, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(13, 0, 0, BLUE_LOW1);
-            break;
-
-        case 47:
-            ledStrip85.setPixelColor(12, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(13, 0, 0, BLUE_LOW2);
-            break;
-
-        case 48:
-            ledStrip85.setPixelColor(12, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(13, 0, 0, BLUE_LOW3);
-            break;
-
-        case 49:
-            ledStrip85.setPixelColor(12, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(13, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-        
-        case 50:
-            ledStrip85.setPixelColor(14, 0, 0, BLUE_HIGH);
-            break;
-
-        case 51:
-            ledStrip85.setPixelColor(14, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(15, 0, 0, BLUE_LOW1);
-            break;
-
-        case 52:
-            ledStrip85.setPixelColor(14, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(15, 0, 0, BLUE_LOW2);
-            break;
-
-        case 53:
-            ledStrip85.setPixelColor(14, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(15, 0, 0, BLUE_LOW3);
-            break;
-
-        case 54:
-            ledStrip85.setPixelColor(14, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(15, 0, 0, BLUE_LOW4);
-            break;            
-
-        //-------------------------------------------------------------------------------------
-
-        case 55:
-            ledStrip85.setPixelColor(16, 0, 0, BLUE_HIGH);
-            break;
-
-        case 56:
-            ledStrip85.setPixelColor(16, 0, 0, BLUE_LOW4);
-            ledStrip85.setPixelColor(17, 0, 0, BLUE_LOW1);
-            break;
-
-        case 57:
-            ledStrip85.setPixelColor(16, 0, 0, BLUE_LOW3);
-            ledStrip85.setPixelColor(17, 0, 0, BLUE_LOW2);
-            break;
-
-        case 58:
-            ledStrip85.setPixelColor(16, 0, 0, BLUE_LOW2);
-            ledStrip85.setPixelColor(17, 0, 0, BLUE_LOW3);
-            break;
-
-        case 59:
-            ledStrip85.setPixelColor(16, 0, 0, BLUE_LOW1);
-            ledStrip85.setPixelColor(17, 0, 0, BLUE_LOW4);
-            break;            
-    }
-
-    ledStrip85.show();
-    ledStrip65.show();
+    // Both rings latch together, a ring that shows the same picture again is not pushed
+    leds.show();
 
     critical_section_exit(&myLock);
 }
 
-void test1(WS2812 ledStrip85, WS2812 ledStrip65)
+void test1(WS2812 &ledStrip85, WS2812 &ledStrip65)
 {
     // 1. Set all LEDs to red!
     printf("1. Set all LEDs to red!");
@@ -1203,7 +697,7 @@ void test1(WS2812 ledStrip85, WS2812 ledStrip65)
     }
 }
 
-void test2(WS2812 ledStrip85, WS2812 ledStrip65)
+void test2(WS2812 &ledStrip85, WS2812 &ledStrip65)
 {
     // zero the entire display
     memset(buf, 0, SSD1306_BUF_LEN);
@@ -1223,7 +717,7 @@ void test2(WS2812 ledStrip85, WS2812 ledStrip65)
     }
 }
 
-void test3(WS2812 ledStrip85, WS2812 ledStrip65)
+void test3(WS2812 &ledStrip85, WS2812 &ledStrip65)
 {
     // zero the entire display
     memset(buf, 0, SSD1306_BUF_LEN);
@@ -1314,6 +808,18 @@ bool readWiFiConfig()
     
     printf("\r\n");
 
+    // Optional third line: time zone rule, e.g. CET-1CEST,M3.5.0,M10.5.0/3
+    char line[sizeof(tzRule)];
+    if (f_gets(line, sizeof(line), &fil))
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0])
+        {
+            strcpy(tzRule, line);
+            printf("Time zone %s\r\n", tzRule);
+        }
+    }
+
     // Close file
     f_close(&fil);
 
@@ -1329,14 +835,48 @@ bool readWiFiConfig()
  */
 int main() 
 {
+    // After a watchdog reset the clock runs again before anything else is initialized
+    timekeeping_init();
+    holdover_init();
+    bool warmRestart = warm_restart_restore();
+
     stdio_init_all();
+
+    // After power-on the clock at least runs at the rate learned before
+    if (!warmRestart)
+    {
+        drift_file_restore();
+    }
     critical_section_init(&myLock);
 
-    gpio_init(BUTTON_DST);
-    gpio_set_dir(BUTTON_DST, GPIO_IN);
+    // I2C is "open drain", pull ups to keep signal high when no data is being sent.
+    // The bus is shared by the display and the RTC. The RTC is read first, so the clock
+    // runs within milliseconds, long before the network is up.
+    i2c_init(/*i2c_default*/ i2c1, SSD1306_I2C_CLK * 1000);
+    gpio_set_function(PICO_SECOND_I2C_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(PICO_SECOND_I2C_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(PICO_SECOND_I2C_SDA_PIN);
+    gpio_pull_up(PICO_SECOND_I2C_SCL_PIN);
+
+    time_source_register(ds3231_time_source(i2c1));
+    time_source_register(ntp_client_time_source());
+    if (TIME_BEACON_ROLE == TIME_BEACON_FOLLOWER)
+    {
+        time_source_register(time_beacon_time_source());
+    }
+#ifdef PTP_DOMAIN
+    time_source_register(ptp_client_time_source());
+#endif
+    time_source_poll();
 
     bool wifiConfig = readWiFiConfig();
 
+    if (!time_zone_parse(&localZone, tzRule))
+    {
+        printf("Invalid time zone rule '%s', using %s\n", tzRule, TZ_RULE);
+        time_zone_parse(&localZone, TZ_RULE);
+    }
+
     if (cyw43_arch_init()) 
     {
         printf("failed to initialise\n");
@@ -1347,14 +887,18 @@ int main()
     cyw43_arch_enable_sta_mode();
 
     int result;
+    const char *ssid = wifiConfig ? wifiSSID : WIFI_SSID;
+    const char *password = wifiConfig ? wifiPwd : WIFI_PASSWORD;
 
-    if (wifiConfig)
+    if (warmRestart)
     {
-        result = cyw43_arch_wifi_connect_timeout_ms(wifiSSID, wifiPwd, CYW43_AUTH_WPA2_AES_PSK, 10000);
+        // Clock is already set, the display does not wait for the network
+        printf("Warm restart, time kept\n");
+        result = cyw43_arch_wifi_connect_async(ssid, password, CYW43_AUTH_WPA2_AES_PSK);
     }
     else
     {
-         result = cyw43_arch_wifi_connect_timeout_ms(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK, 10000);
+        result = cyw43_arch_wifi_connect_timeout_ms(ssid, password, CYW43_AUTH_WPA2_AES_PSK, 10000);
     }
 
     if (result) 
@@ -1362,8 +906,7 @@ int main()
         printf("Failed to connect. Error code: %d\n", result);
         printf(WIFI_SSID);
         printf(WIFI_PASSWORD);
-        sleep_ms(3000);
-        return 0;
+        printf("Continuing without network, time from RTC only\n");
     }
 
     //----------------------------------------------------------------------------------------
@@ -1378,13 +921,6 @@ int main()
     bi_decl(bi_2pins_with_func(PICO_SECOND_I2C_SDA_PIN, PICO_SECOND_I2C_SCL_PIN, GPIO_FUNC_I2C));
     bi_decl(bi_program_description("SSD1306 OLED driver I2C example for the Raspberry Pi Pico"));
 
-    // I2C is "open drain", pull ups to keep signal high when no data is being sent
-    i2c_init(/*i2c_default*/ i2c1, SSD1306_I2C_CLK * 1000);
-    gpio_set_function(PICO_SECOND_I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(PICO_SECOND_I2C_SCL_PIN, GPIO_FUNC_I2C);
-    gpio_pull_up(PICO_SECOND_I2C_SDA_PIN);
-    gpio_pull_up(PICO_SECOND_I2C_SCL_PIN);
-
     // run through the complete initialization process
     SSD1306_init();
 
@@ -1395,7 +931,7 @@ int main()
     render(buf, &frame_area);
 
     // intro sequence: flash the screen 3 times
-    for (int i = 0; i < 3; i++) {
+    for (int i = 0; i < (warmRestart ? 0 : 3); i++) {
         SSD1306_send_cmd(SSD1306_SET_ALL_ON);    // Set all pixels on
         sleep_ms(500);
         SSD1306_send_cmd(SSD1306_SET_ENTIRE_ON); // go back to following RAM for pixel state
@@ -1424,71 +960,168 @@ int main()
     sleep_ms(100);
 
     //----------------------------------------------------------------------------------------
-    // I found this (unconfirmed) info:
-    //
-    // The CYW43 driver gets installed in PIO1 by default, and only uses PIO0 if there's no space.
-    //
-    // So I hope that using PIO0 SM2 and SM3 avoid collision
+    // State machines are claimed dynamically, after cyw43_arch_init() took the one for the Wi-Fi SPI
 
-    if (pio_sm_is_claimed(pio0, 2))
+    if (leds.begin() < count_of(ledConfig))
     {
-        printf("PIO0 SM2 is claimed\n");
+        printf("Not enough free PIO state machines for %u LED strips\n", count_of(ledConfig));
+        sleep_ms(3000);
+        return 0;
     }
 
-WS2812 ledStrip85(
-        LED_PIN85,          // Data line (GP14)
-        LED_LENGTH,         // Strip is 24 LEDs long.
-        pio0,               // Use PIO 0 for creating the state machine.
-        2,                  // Index of the state machine that will be created for controlling the LED strip
-                            // You can have 4 state machines per PIO-Block up to 8 overall.
-                            // See Chapter 3 in: https://datasheets.raspberrypi.org/rp2040/rp2040-datasheet.pdf
-        WS2812::FORMAT_GRB  // Pixel format used by the LED strip was: FORMAT_GRB FORMAT_RGB
-    );
-
-    if (pio_sm_is_claimed(pio0, 3))
+    WS2812 &ledStrip85 = leds.strip(0);
+    WS2812 &ledStrip65 = leds.strip(1);
+
+    if (!warmRestart)
     {
-        printf("PIO0 SM3 is claimed\n");
-    }
+        test2(ledStrip85, ledStrip65);
+        clear(ledStrip85);
+        clear(ledStrip65);
 
-WS2812 ledStrip65(
-        LED_PIN65,          // Data line (GP15)
-        LED_LENGTH,         // Strip is 24 LEDs long.
-        pio0,               // Use PIO 0 for creating the state machine.
-        3,                  // Index of the state machine that will be created for controlling the LED strip
-                            // You can have 4 state machines per PIO-Block up to 8 overall.
-                            // See Chapter 3 in: https://datasheets.raspberrypi.org/rp2040/rp2040-datasheet.pdf
-        WS2812::FORMAT_GRB  // Pixel format used by the LED strip was: FORMAT_GRB FORMAT_RGB
-    );
-
-    test2(ledStrip85, ledStrip65);
-    clear(ledStrip85);
-    clear(ledStrip65);
-
-    test3(ledStrip85, ledStrip65);
-    clear(ledStrip85);
-    clear(ledStrip65);
+        test3(ledStrip85, ledStrip65);
+        clear(ledStrip85);
+        clear(ledStrip65);
+    }
     
     //test1(ledStrip85, ledStrip65);
     //clear(ledStrip85);
     //clear(ledStrip65);
 
+    //pixel_kernels_benchmark();
+
     //=========================================================================================================
 
-    NTP_T *state = ntp_init();
+    // Addresses of the NTP servers are kept with their TTL, a new sync needs no DNS round trip
+    cyw43_arch_lwip_begin();
+    dns_cache_init();
+    cyw43_arch_lwip_end();
+
+    for (uint i = 0; i < count_of(ntpServers); i++)
+    {
+        ntp_client_add_server(ntpServers[i]);
+    }
+    ntp_client_init();
+
+    // Other devices in the LAN may sync to this clock
+    cyw43_arch_lwip_begin();
+    sntp_server_init();
+    if (!time_beacon_init(TIME_BEACON_ROLE))
+    {
+        printf("Time beacons not available\n");
+    }
+#ifdef PTP_DOMAIN
+    if (!ptp_client_init(PTP_DOMAIN))
+    {
+        printf("PTP not available\n");
+    }
+#endif
+    cyw43_arch_lwip_end();
+
+    // Every NTP update moves the ticks to the new second boundaries
+    timekeeping_set_callback(tick_scheduler_rephase);
+    tick_scheduler_start();
+
+    // The screen of the next second is drawn ahead, the tick only sends it
+    int64_t drawnSecond = -1;
+    uint64_t nextSweep = 0;
+
+    // A hung loop resets the board, the clock survives it (warm_restart.c)
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
 
     while (true)
     {
+        warm_restart_feed();
+
         //----------------------------------------------------------------------------------------
-        run_ntp_test(state);
-        
-        struct tm *utc = gmtime(&epoch);
-        
-        displayTime(utc, ledStrip85, ledStrip65);
+        // NTP polls run on the async context, the clock is set from their results here
+        ntp_client_service();
+        time_beacon_service();
+        ptp_client_service();
 
-        sleep_ms(3000);
-    }
+        tick_t tick;
+        if (tick_scheduler_poll(&tick))
+        {
+            if (tick.second != drawnSecond)
+            {
+                drawTime(tick.second);  // Clock was set since
+            }
+            displayTime(ledStrip85, ledStrip65);
+            time_beacon_on_second();
+
+            drawnSecond = tick.second + 1;
+            drawTime(drawnSecond);
+
+            // RTC is set on the boundary after each NTP update
+            time_source_on_second(tick.second);
+            warm_restart_save(false);
+
+            // Temperature compensation of the crystal
+            if (tick.second % 10 == 0)
+            {
+                holdover_sample();
+            }
+
+            if (tick.minute)
+            {
+                drift_file_service();
 
-    free(state);
+                tick_stats_t stats;
+                tick_scheduler_stats(&stats);
+                printf("tick jitter: alarm %d us (max %d, mean %u), display %d us (max %d), missed %u\n",
+                       (int)stats.alarm_last, (int)stats.alarm_max, (uint)stats.alarm_mean,
+                       (int)stats.dispatch_last, (int)stats.dispatch_max, (uint)stats.missed);
+
+                sntp_server_stats_t server;
+                sntp_server_stats(&server);
+                if (server.requests)
+                {
+                    printf("sntp server: %u requests, %u replies, %u dropped, latency %u us (max %u)\n",
+                           (uint)server.requests, (uint)server.replies, (uint)server.dropped,
+                           (uint)server.latency_mean_us, (uint)server.latency_max_us);
+                }
+
+                time_beacon_stats_t beacons;
+                time_beacon_stats(&beacons);
+                if (beacons.sent || beacons.received)
+                {
+                    printf("time beacons: %u sent, %u received, %u lost, %u invalid, last offset %lld us\n",
+                           (uint)beacons.sent, (uint)beacons.received, (uint)beacons.lost,
+                           (uint)beacons.invalid, (long long)beacons.last_offset_us);
+                }
+
+                ptp_client_stats_t ptp;
+                ptp_client_stats(&ptp);
+                if (ptp.exchanges)
+                {
+                    printf("ptp: %u exchanges, %u missed, offset mean %lld us rms %u us max %u us, delay %u us\n",
+                           (uint)ptp.exchanges, (uint)ptp.missed, (long long)ptp.offset_mean_us,
+                           (uint)ptp.offset_rms_us, (uint)ptp.offset_max_us, (uint)ptp.delay_mean_us);
+                }
+            }
+        }
+
+        uint64_t wakeUp = tick_scheduler_next_us();
+#if SECOND_HAND_FPS
+        if (drawnSecond >= 0 && time_us_64() >= nextSweep)
+        {
+            sweepSecondHand(ledStrip85, ledStrip65);
+            nextSweep = time_us_64() + 1000000 / SECOND_HAND_FPS;
+        }
+        wakeUp = MIN(wakeUp, nextSweep);
+#endif
+
+#if PICO_CYW43_ARCH_POLL 
+        // if you are using pico_cyw43_arch_poll, then you must poll periodically from your
+        // main loop (not from a timer interrupt) to check for Wi-Fi driver or lwIP work that needs to be done.
+        cyw43_arch_poll();
+        // Sleep until cyw43_arch_poll() has work to do (packets, NTP workers), the next second starts or the second hand moves
+        cyw43_arch_wait_for_work_until(from_us_since_boot(wakeUp));
+#else
+        // WiFI driver and lwIP work is done via interrupt in the background,
+        // the tick alarm and a finished NTP poll send an event
+        best_effort_wfe_or_timeout(from_us_since_boot(wakeUp));
+#endif
+    }
 
 #endif
 
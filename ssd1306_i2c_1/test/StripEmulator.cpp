@@ -0,0 +1,121 @@
+#include <stdio.h>
+
+#include "StripEmulator.hpp"
+#include "mock_hardware.h"
+
+StripEmulator *StripEmulator::emulators[MAX_EMULATORS] = {};
+
+StripEmulator::StripEmulator(WS2812 &strip) : strip(strip), pixels(strip.getLength(), 0) {
+    for (uint i = 0; i < MAX_EMULATORS; i++) {
+        if (!emulators[i]) {
+            emulators[i] = this;
+            break;
+        }
+    }
+    mock_pio_set_line_hook(onLine, nullptr);
+}
+
+StripEmulator::~StripEmulator() {
+    for (uint i = 0; i < MAX_EMULATORS; i++) {
+        if (emulators[i] == this) {
+            emulators[i] = nullptr;
+        }
+    }
+}
+
+void StripEmulator::onLine(uint pioIndex, uint sm, uint32_t word, uint bits, uint64_t startNs, void *context) {
+    (void)context;
+    for (uint i = 0; i < MAX_EMULATORS; i++) {
+        StripEmulator *e = emulators[i];
+        if (e && pio_get_index(e->strip.getPio()) == pioIndex && e->strip.getSm() == sm) {
+            e->receive(word, bits, startNs);
+        }
+    }
+}
+
+// The state machine shifts out the MSBs of the word
+void StripEmulator::receive(uint32_t word, uint bits, uint64_t start) {
+    if (!wire.empty() && start >= endNs + LATCH_US * 1000ull) {
+        latch();
+    }
+    if (wire.empty()) {
+        startNs = start;
+    }
+    for (uint b = 0; b < bits / 8; b++) {
+        wire.push_back((uint8_t)(word >> (24 - 8 * b)));
+    }
+    endNs = start + (uint64_t)bits * MOCK_PIO_BIT_NS;
+}
+
+// Every LED takes the first pixel it sees and passes the rest on, bytes beyond the strip are lost
+void StripEmulator::latch() {
+    uint bytesPerPixel = strip.getBytesPerPixel();
+    uint count = MIN((uint)(wire.size() / bytesPerPixel), strip.getLength());
+    for (uint i = 0; i < count; i++) {
+        pixels[i] = strip.decodeWire(&wire[i * bytesPerPixel]);
+    }
+    frames.push_back({ startNs, endNs, pixels });
+    wire.clear();
+}
+
+void StripEmulator::latchIfIdle() {
+    if (!wire.empty() && mock_time_ns() >= endNs + LATCH_US * 1000ull) {
+        latch();
+    }
+}
+
+const std::vector<StripEmulator::Frame> &StripEmulator::getFrames() {
+    latchIfIdle();
+    return frames;
+}
+
+void StripEmulator::clearFrames() {
+    latchIfIdle();
+    frames.clear();
+}
+
+const std::vector<uint32_t> &StripEmulator::getPixels() {
+    latchIfIdle();
+    return pixels;
+}
+
+std::string StripEmulator::toText(const std::vector<uint32_t> &pixels) {
+    std::string text;
+    char token[16];
+    for (uint32_t p : pixels) {
+        if (!p) {
+            text += " .";
+            continue;
+        }
+        uint32_t rgb = (p & 0xFF) << 16 | (p & 0xFF00) | (p >> 16 & 0xFF);
+        if (p >> 24) {
+            snprintf(token, sizeof(token), " %02X%06X", (unsigned)(p >> 24), (unsigned)rgb);
+        } else {
+            snprintf(token, sizeof(token), " %06X", (unsigned)rgb);
+        }
+        text += token;
+    }
+    return text.empty() ? text : text.substr(1);
+}
+
+bool StripEmulator::writePpm(const char *path, const std::vector<std::vector<uint32_t>> &rows, uint scale) {
+    size_t width = 0;
+    for (const std::vector<uint32_t> &row : rows) {
+        width = MAX(width, row.size());
+    }
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "P6\n%zu %zu\n255\n", width * scale, rows.size() * scale);
+    for (const std::vector<uint32_t> &row : rows) {
+        for (uint y = 0; y < scale; y++) {
+            for (size_t x = 0; x < width * scale; x++) {
+                uint32_t p = x / scale < row.size() ? row[x / scale] : 0;
+                uint8_t rgb[3] = { (uint8_t)p, (uint8_t)(p >> 8), (uint8_t)(p >> 16) };
+                fwrite(rgb, 1, 3, f);
+            }
+        }
+    }
+    return fclose(f) == 0;
+}
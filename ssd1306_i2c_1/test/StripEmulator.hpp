@@ -0,0 +1,60 @@
+#ifndef STRIP_EMULATOR_H
+#define STRIP_EMULATOR_H
+
+#include <string>
+#include <vector>
+
+#include "WS2812.hpp"
+
+/**
+ * WS2812 strip on the line of a mocked PIO state machine (see mock_hardware.h).
+ *
+ * Collects the bits the state machine shifts out and latches them like the LEDs do: a frame ends when
+ * the line stayed low for LATCH_US. The wire bytes are decoded with the color order of the strip, the
+ * first pixels of a short frame change and the rest keep their colors. Frames keep the times they
+ * were on the line, so tests can check the wire time and how strips start together.
+ */
+class StripEmulator {
+    public:
+        static const uint LATCH_US = 50;
+
+        struct Frame {
+            uint64_t startNs;               // First bit on the line
+            uint64_t endNs;                 // End of the last bit, the LEDs latch LATCH_US later
+            std::vector<uint32_t> pixels;   // What the strip shows after the frame, as WS2812::RGB(W)
+        };
+
+        StripEmulator(WS2812 &strip);
+        ~StripEmulator();
+
+        // Latched frames, the pending one is included once the line is low for LATCH_US
+        const std::vector<Frame> &getFrames();
+        void clearFrames();
+
+        // Colors the LEDs show now
+        const std::vector<uint32_t> &getPixels();
+
+        // One token per LED: '.' when dark, else RRGGBB (WWRRGGBB with a white channel)
+        static std::string toText(const std::vector<uint32_t> &pixels);
+
+        // Binary PPM, one row of LEDs per entry, every LED a scale x scale square
+        static bool writePpm(const char *path, const std::vector<std::vector<uint32_t>> &rows, uint scale);
+
+    private:
+        WS2812 &strip;
+        std::vector<uint8_t> wire;          // Bytes of the frame on the line
+        uint64_t startNs = 0;
+        uint64_t endNs = 0;
+        std::vector<uint32_t> pixels;
+        std::vector<Frame> frames;
+
+        static const uint MAX_EMULATORS = 8;
+        static StripEmulator *emulators[MAX_EMULATORS];
+
+        static void onLine(uint pioIndex, uint sm, uint32_t word, uint bits, uint64_t startNs, void *context);
+        void receive(uint32_t word, uint bits, uint64_t startNs);
+        void latch();
+        void latchIfIdle();
+};
+
+#endif
@@ -0,0 +1,29 @@
+/* check.h
+ *
+ * Assertions of the host tests: a failed check is reported and the test goes on,
+ * check_result() gives the exit code.
+ */
+#pragma once
+
+#include <stdio.h>
+
+static int check_failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures++; \
+        } \
+    } while (0)
+
+static inline int check_result(void)
+{
+    if (check_failures)
+    {
+        printf("%d checks failed\n", check_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,56 @@
+/* civil_time_benchmark.c
+ *
+ * civil_from_unix() against the C library's gmtime_r(): speed, and every day from 1970 to 2106
+ * (the end of unsigned 32-bit seconds) must give the same date and convert back.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "pico/types.h"
+#include "civil_time.h"
+#include "mock_hardware.h"
+#include "check.h"
+
+int main(void)
+{
+    civil_time_t t;
+    struct tm tm;
+    const uint rounds = 100000;
+    const int64_t step = 86400 * 37 + 3601;     // Walks through all days of week, months and hours
+    volatile uint32_t sink = 0;
+
+    uint64_t t0 = host_time_us();
+    for (uint i = 0; i < rounds; i++)
+    {
+        civil_from_unix(i * step, &t);
+        sink += t.day;
+    }
+    uint64_t t1 = host_time_us();
+    for (uint i = 0; i < rounds; i++)
+    {
+        time_t s = (time_t)(i * step);
+        gmtime_r(&s, &tm);
+        sink += tm.tm_mday;
+    }
+    uint64_t t2 = host_time_us();
+    printf("Date conversion x %u: civil %llu us, gmtime_r %llu us\n", rounds,
+           (unsigned long long)(t1 - t0), (unsigned long long)(t2 - t1));
+
+    uint errors = 0;
+    for (int64_t s = 0; s < 0x100000000LL; s += 86400 + 1)
+    {
+        time_t ts = (time_t)s;
+        civil_from_unix(s, &t);
+        gmtime_r(&ts, &tm);
+        if (t.year != tm.tm_year + 1900 || t.month != tm.tm_mon + 1 || t.day != tm.tm_mday ||
+            t.hour != tm.tm_hour || t.minute != tm.tm_min || t.second != tm.tm_sec ||
+            t.weekday != tm.tm_wday || t.yday != tm.tm_yday || civil_to_unix(&t) != s)
+        {
+            errors++;
+        }
+    }
+    printf("Date conversion 1970..2106 check: %u errors\n", errors);
+    CHECK(errors == 0);
+
+    return check_result();
+}
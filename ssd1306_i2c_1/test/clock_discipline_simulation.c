@@ -0,0 +1,87 @@
+/* clock_discipline_simulation.c
+ *
+ * Disciplines a synthetic drifting oscillator from noisy offsets for two days and prints how the
+ * offset, the frequency and the poll interval converge. On the second day the loop must hold the
+ * clock within a few ms of the NTP noise and have backed off its poll interval.
+ */
+#include <stdio.h>
+#include <math.h>
+
+#include "clock_discipline.h"
+#include "check.h"
+
+// Gaussian noise, Box-Muller on a linear congruential generator
+static double sim_noise(uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    double u1 = ((*seed >> 8) + 1) / 16777217.0;
+    *seed = *seed * 1664525u + 1013904223u;
+    double u2 = (*seed >> 8) / 16777216.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+int main(void)
+{
+    clock_discipline_t d;
+    clock_discipline_init(&d);
+    uint32_t seed = 1;
+    const double step = 10;             // s, the holdover sample period
+
+    // Oscillator 12 ppm fast, daily temperature swing of ±2 ppm, slow random walk.
+    // NTP over Wi-Fi: 1.5 ms RMS offset noise.
+    double walk = 0;
+    double trueTime = 0, localTime = 0.05;  // Starts 50 ms ahead
+    double nextPoll = 0, lastPoll = 0;
+    double sumSq = 0, maxAbs = 0, pollSum = 0;
+    uint32_t polls = 0, pollsLastDay = 0;
+
+    printf("Discipline:   hour  offset ms  drift ppm  wander ppb  poll s\n");
+    for (double t = 0; t < 2 * 86400; t += step)
+    {
+        walk += sim_noise(&seed) * 0.002;
+        double ppm = 12 + 2 * sin(t * 2 * M_PI / 86400) + walk;
+        double rate = clock_discipline_rate_ppb(&d) * 1e-9;
+        trueTime += step;
+        localTime += step * (1 + ppm * 1e-6) * (1 + rate);
+        clock_discipline_advance(&d, (uint64_t)(step * 1e6));
+
+        double offset = trueTime - localTime;
+        if (t >= 86400)
+        {
+            sumSq += offset * offset;
+            maxAbs = fmax(maxAbs, fabs(offset));
+        }
+
+        if (t >= nextPoll)
+        {
+            int64_t measured = (int64_t)((offset + sim_noise(&seed) * 0.0015) * 1e6);
+            uint32_t interval = polls ? (uint32_t)(t - lastPoll) : 0;
+            if (!clock_discipline_update(&d, measured, interval))
+            {
+                localTime += measured * 1e-6;   // Step
+            }
+            lastPoll = t;
+            nextPoll = t + (1u << d.poll);
+            polls++;
+            if (t >= 86400)
+            {
+                pollSum += 1u << d.poll;
+                pollsLastDay++;
+            }
+        }
+
+        if (fmod(t, 4 * 3600) == 0)
+        {
+            printf("Discipline: %6.0f  %9.3f  %9.3f  %10.1f  %6u\n", t / 3600, offset * 1000,
+                   -d.freq_ppb / 1000, d.wander_ppb, 1u << d.poll);
+        }
+    }
+    printf("Discipline 2nd day: RMS offset %.3f ms, max %.3f ms, %u polls, mean poll %.0f s\n",
+           sqrt(sumSq / (86400 / step)) * 1000, maxAbs * 1000, pollsLastDay, pollSum / pollsLastDay);
+
+    CHECK(sqrt(sumSq / (86400 / step)) < 0.003);
+    CHECK(maxAbs < 0.01);
+    CHECK(pollSum / pollsLastDay > 64);
+
+    return check_result();
+}
@@ -0,0 +1,185 @@
+// Golden test of the clock face. All 720 hour / minute positions go through the Compositor, LedOutputs
+// and the mocked PIO the way setDateTime() pushes them, are decoded from the line and compared with the golden file.
+// The golden file was recorded from the switch statement setDateTime() had before the frames were generated,
+// on the same mocked PIO, so the test shows that the generated frames are the ones the switch drew.
+// Writes clock_face.ppm (one row per position: outer ring, a dark LED, inner ring) and, when the face
+// changed, clock_face.actual.txt next to it. Run with --update to make the current face the golden one.
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "LedOutputs.hpp"
+#include "ClockFace.hpp"
+#include "Compositor.hpp"
+#include "StripEmulator.hpp"
+#include "mock_hardware.h"
+#include "check.h"
+
+static const LedOutputs::Config ledConfig[] = {
+    { 14, ClockFace::RING_LEDS, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED },  // Outer ring
+    { 15, ClockFace::RING_LEDS, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED },  // Inner ring
+};
+
+static const uint MAX_DIFFS = 10;
+
+static std::vector<std::string> readLines(const char *path) {
+    std::vector<std::string> lines;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+static bool writeLines(const char *path, const std::vector<std::string> &lines) {
+    std::ofstream out(path);
+    for (const std::string &line : lines) {
+        out << line << '\n';
+    }
+    return out.good();
+}
+
+static std::vector<std::string> tokens(const std::string &line) {
+    std::vector<std::string> result;
+    size_t pos = 0;
+    while (pos < line.size()) {
+        size_t end = line.find(' ', pos);
+        if (end == std::string::npos) {
+            end = line.size();
+        }
+        result.push_back(line.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return result;
+}
+
+// Lines are "HH:MM" followed by the outer and the inner ring, see StripEmulator::toText()
+static const uint INNER_TOKEN = 1 + ClockFace::RING_LEDS;
+
+// The one place where the generated face differs from the switch on purpose: at 4 o'clock the hour hand
+// is on inner LED 23 and the switch dropped the quarter glow on the LED after it, the face wraps it to LED 0
+static bool knownChange(uint hours, uint minutes, size_t token, const std::string &was, const std::string &is) {
+    return hours == 4 && minutes < 30 && token == INNER_TOKEN && was == "."
+        && is == (minutes < 15 ? "010000" : "020000");
+}
+
+static bool onlyKnownChanges(uint hours, uint minutes, const std::string &expected, const std::string &actual) {
+    std::vector<std::string> e = tokens(expected);
+    std::vector<std::string> a = tokens(actual);
+    if (e.size() != a.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < e.size(); i++) {
+        if (e[i] != a[i] && !knownChange(hours, minutes, i, e[i], a[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printDiff(const std::string &expected, const std::string &actual) {
+    std::vector<std::string> e = tokens(expected);
+    std::vector<std::string> a = tokens(actual);
+    printf("%s differs:\n", a.empty() ? "?" : a[0].c_str());
+    for (size_t i = 1; i < MAX(e.size(), a.size()); i++) {
+        const char *was = i < e.size() ? e[i].c_str() : "-";
+        const char *is = i < a.size() ? a[i].c_str() : "-";
+        if (strcmp(was, is) != 0) {
+            uint led = (uint)(i - 1);
+            printf("    %s LED %2u: expected %s, got %s\n", led < ClockFace::RING_LEDS ? "outer" : "inner",
+                   led % ClockFace::RING_LEDS, was, is);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: clock_face_test <golden file> [--update]\n");
+        return 2;
+    }
+    const char *golden = argv[1];
+    bool update = argc > 2 && strcmp(argv[2], "--update") == 0;
+
+    mock_hardware_reset();
+    pio_sm_claim(pio1, 0);     // Taken by the Wi-Fi driver on the board
+    LedOutputs leds(ledConfig, count_of(ledConfig));
+    CHECK(leds.begin() == count_of(ledConfig));
+    StripEmulator outer(leds.strip(0));
+    StripEmulator inner(leds.strip(1));
+    Compositor outerFace(ClockFace::RING_LEDS);
+    Compositor innerFace(ClockFace::RING_LEDS);
+
+    std::vector<std::string> lines;
+    std::vector<std::vector<uint32_t>> rows;
+    uint together = 0;
+    for (uint hours = 0; hours < 12; hours++) {
+        for (uint minutes = 0; minutes < 60; minutes++) {
+            outer.clearFrames();
+            inner.clearFrames();
+            outerFace.setFrame(Compositor::LAYER_TICKS, ClockFace::outer(minutes));
+            innerFace.setFrame(Compositor::LAYER_TICKS, ClockFace::inner(hours, minutes));
+            outerFace.compose(leds.strip(0));
+            innerFace.compose(leds.strip(1));
+            leds.show();
+            leds.strip(0).waitIdle();
+            leds.strip(1).waitIdle();
+
+            // A frame that did not change is not pushed again, the ring keeps showing it
+            const std::vector<StripEmulator::Frame> &o = outer.getFrames();
+            const std::vector<StripEmulator::Frame> &i = inner.getFrames();
+            CHECK(o.size() <= 1 && i.size() <= 1);
+            if (!o.empty() && !i.empty()) {
+                CHECK(o[0].startNs == i[0].startNs);
+                together++;
+            }
+
+            char time[8];
+            snprintf(time, sizeof(time), "%02u:%02u", hours, minutes);
+            lines.push_back(std::string(time) + " " + StripEmulator::toText(outer.getPixels()) + " "
+                            + StripEmulator::toText(inner.getPixels()));
+
+            std::vector<uint32_t> row = outer.getPixels();
+            row.push_back(0);
+            row.insert(row.end(), inner.getPixels().begin(), inner.getPixels().end());
+            rows.push_back(row);
+        }
+    }
+    printf("720 positions, both rings pushed together %u times\n", together);
+    CHECK(together > 0);
+    CHECK(StripEmulator::writePpm("clock_face.ppm", rows, 4));
+
+    if (update) {
+        CHECK(writeLines(golden, lines));
+        printf("Golden file %s updated\n", golden);
+        return check_result();
+    }
+
+    std::vector<std::string> expected = readLines(golden);
+    CHECK(expected.size() == lines.size());
+    uint diffs = 0;
+    uint known = 0;
+    for (size_t n = 0; n < MIN(expected.size(), lines.size()); n++) {
+        if (expected[n] != lines[n]) {
+            if (onlyKnownChanges((uint)n / 60, (uint)n % 60, expected[n], lines[n])) {
+                known++;
+                continue;
+            }
+            if (diffs < MAX_DIFFS) {
+                printDiff(expected[n], lines[n]);
+            }
+            diffs++;
+        }
+    }
+    printf("%u positions differ from the golden file only by the quarter glow after inner LED 23\n", known);
+    if (diffs || expected.size() != lines.size()) {
+        writeLines("clock_face.actual.txt", lines);
+        printf("%u of %zu positions differ from %s, see clock_face.actual.txt and clock_face.ppm\n",
+               diffs, lines.size(), golden);
+        CHECK(diffs == 0);
+    }
+    return check_result();
+}
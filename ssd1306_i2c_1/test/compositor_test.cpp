@@ -0,0 +1,170 @@
+// Compositor: the two-lanes-per-word blends against a per channel reference, for every alpha,
+// and which compose() calls blend again
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Compositor.hpp"
+#include "ClockFace.hpp"
+#include "HandRenderer.hpp"
+#include "mock_hardware.h"
+#include "check.h"
+
+static const uint LENGTH = 256;     // One pixel per alpha value
+
+// Pixels of the last frame handed to the capture hook
+static std::vector<uint32_t> captured;
+
+static void onCapture(WS2812 &strip, uint first, const uint8_t *wire, uint count, uint64_t frameUs, void *context) {
+    (void)frameUs;
+    (void)context;
+    captured.resize(strip.getLength());
+    for (uint i = 0; i < count; i++) {
+        captured[first + i] = strip.decodeWire(&wire[i * strip.getBytesPerPixel()]);
+    }
+}
+
+static uint8_t channel(uint32_t color, uint c) {
+    return (uint8_t)(color >> (8 * c));
+}
+
+// Same rounding as the compositor: alpha 255 counts as 256, so an opaque pixel replaces the one below
+static uint32_t referenceOver(uint32_t dst, uint32_t src, uint alpha) {
+    uint a = alpha + (alpha >> 7);
+    uint32_t result = 0;
+    for (uint c = 0; c < 3; c++) {
+        result |= (uint32_t)((channel(src, c) * a + channel(dst, c) * (256 - a)) >> 8) << (8 * c);
+    }
+    return result;
+}
+
+static uint32_t referenceAdd(uint32_t dst, uint32_t src, uint alpha) {
+    uint a = alpha + (alpha >> 7);
+    uint32_t result = 0;
+    for (uint c = 0; c < 3; c++) {
+        uint v = channel(dst, c) + ((channel(src, c) * a) >> 8);
+        result |= (uint32_t)(v > 255 ? 255 : v) << (8 * c);
+    }
+    return result;
+}
+
+static void testBlend(Compositor::BlendMode mode, uint32_t below, uint32_t color) {
+    mock_hardware_reset();
+    WS2812 strip(2, LENGTH, pio0, 0, WS2812::FORMAT_GRB);
+    Compositor compositor(LENGTH);
+    compositor.setBlendMode(Compositor::LAYER_SECONDS, mode);
+    for (uint i = 0; i < LENGTH; i++) {
+        compositor.setPixel(Compositor::LAYER_TICKS, i, below);
+        compositor.setPixel(Compositor::LAYER_SECONDS, i, color, (uint8_t)i);
+    }
+    CHECK(compositor.compose(strip));
+    strip.show();
+
+    uint errors = 0;
+    for (uint i = 0; i < LENGTH; i++) {
+        uint32_t expected = mode == Compositor::BLEND_OVER ? referenceOver(below, color, i) : referenceAdd(below, color, i);
+        if (captured[i] != expected) {
+            if (errors++ < 4) {
+                printf("    alpha %3u: expected %06X, got %06X\n", i, (unsigned)expected, (unsigned)captured[i]);
+            }
+        }
+    }
+    printf("%s %06X over %06X: %u errors\n", mode == Compositor::BLEND_OVER ? "over" : "add ",
+           (unsigned)color, (unsigned)below, errors);
+    CHECK(errors == 0);
+}
+
+// Only a layer that really changed makes compose() blend again
+static void testDirty() {
+    mock_hardware_reset();
+    WS2812 strip(2, 24, pio0, 0, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED);
+    Compositor compositor(24);
+
+    compositor.setPixel(Compositor::LAYER_TICKS, 0, WS2812::RGB(0, 20, 0));
+    compositor.setPixel(Compositor::LAYER_MINUTE, 0, WS2812::RGB(0, 0, 64));
+    CHECK(compositor.compose(strip));
+    CHECK(!compositor.compose(strip));
+
+    // Clearing and drawing the same hand again is no change
+    compositor.clearLayer(Compositor::LAYER_MINUTE);
+    compositor.setPixel(Compositor::LAYER_MINUTE, 0, WS2812::RGB(0, 0, 64));
+    CHECK(!compositor.compose(strip));
+
+    // The result is written even when nothing changed, a strip drawn on directly gets it back
+    strip.show();
+    strip.clear();
+    CHECK(!compositor.compose(strip));
+    strip.show();
+    CHECK(strip.getShowCount() == 1);
+    CHECK(strip.getSkippedShowCount() == 1);
+
+    compositor.setPixel(Compositor::LAYER_SECONDS, 5, WS2812::RGB(16, 8, 0));
+    CHECK(compositor.compose(strip));
+}
+
+// A frame loaded into the bottom layer comes out unchanged
+static void testFrame() {
+    mock_hardware_reset();
+    WS2812 strip(2, 3, pio0, 0, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED);
+    Compositor compositor(3);
+    const uint8_t frame[] = { 20, 0, 0,  0, 0, 0,  1, 255, 64 };   // GRB
+    compositor.setFrame(Compositor::LAYER_TICKS, frame);
+    CHECK(compositor.compose(strip));
+    strip.show();
+    CHECK(captured[0] == WS2812::RGB(0, 20, 0));
+    CHECK(captured[1] == 0);
+    CHECK(captured[2] == WS2812::RGB(255, 1, 64));
+}
+
+// The second hand in a layer added over the face lights the same LEDs as drawn into a copy of the frame,
+// the alpha rounding may differ by one step
+static constexpr HandRenderer secondHand(ClockFace::OUTER_RING);
+
+static void testHand() {
+    mock_hardware_reset();
+    WS2812 strip(2, ClockFace::RING_LEDS, pio0, 0, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED);
+    Compositor compositor(ClockFace::RING_LEDS);
+    compositor.setBlendMode(Compositor::LAYER_SECONDS, Compositor::BLEND_ADD);
+    const uint32_t color = WS2812::RGB(160, 80, 0);
+
+    uint errors = 0;
+    for (uint second = 0; second < 60; second++) {
+        const uint8_t *face = ClockFace::outer(second);
+        uint16_t angle = RingGeometry::angle(second * 1000 + 400, 60000);
+        uint8_t frame[ClockFace::FRAME_BYTES];
+        memcpy(frame, face, sizeof(frame));
+        secondHand.draw(frame, angle, color);
+
+        compositor.setFrame(Compositor::LAYER_TICKS, face);
+        compositor.clearLayer(Compositor::LAYER_SECONDS);
+        secondHand.draw(compositor, Compositor::LAYER_SECONDS, angle, color);
+        compositor.compose(strip);
+        strip.show();
+        for (uint i = 0; i < ClockFace::RING_LEDS; i++) {
+            uint32_t expected = WS2812::RGB(frame[i * 3 + 1], frame[i * 3], frame[i * 3 + 2]);
+            for (uint c = 0; c < 3; c++) {
+                if (abs((int)channel(captured[i], c) - (int)channel(expected, c)) > 1) {
+                    errors++;
+                }
+            }
+        }
+    }
+    printf("second hand in a layer: %u channels off\n", errors);
+    CHECK(errors == 0);
+}
+
+int main() {
+    WS2812::setCaptureHook(onCapture, nullptr);
+    testBlend(Compositor::BLEND_OVER, WS2812::RGB(0, 20, 0), WS2812::RGB(0, 0, 64));
+    testBlend(Compositor::BLEND_OVER, WS2812::RGB(255, 255, 255), WS2812::RGB(1, 128, 254));
+    testBlend(Compositor::BLEND_OVER, WS2812::RGB(200, 0, 100), WS2812::RGB(0, 255, 0));
+    testBlend(Compositor::BLEND_ADD, WS2812::RGB(0, 20, 0), WS2812::RGB(0, 0, 64));
+    testBlend(Compositor::BLEND_ADD, WS2812::RGB(200, 250, 5), WS2812::RGB(100, 255, 251));
+    testBlend(Compositor::BLEND_ADD, WS2812::RGB(255, 255, 255), WS2812::RGB(255, 255, 255));
+    testDirty();
+    testFrame();
+    testHand();
+    return check_result();
+}
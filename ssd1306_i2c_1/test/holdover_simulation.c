@@ -0,0 +1,89 @@
+/* holdover_simulation.c
+ *
+ * Learns synthetic temperature and drift traces, then compares 24 h of holdover with and without
+ * compensation. The temperature model must beat both the free running crystal and a plain mean rate.
+ */
+#include <stdio.h>
+#include <math.h>
+
+#include "holdover.h"
+#include "check.h"
+
+// Crystal with a parabolic temperature curve, turnover at 25 °C
+static float sim_crystal_ppm(float t)
+{
+    return 8.0f - 0.034f * (t - 25.0f) * (t - 25.0f);
+}
+
+// Daily cycle, a heating cycle of about 3 hours and sensor noise
+static float sim_temperature(double seconds, uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    float noise = ((*seed >> 8) / 16777216.0f - 0.5f) * 0.6f;
+    return 20.0f + 7.0f * (float)sin(seconds * 2 * M_PI / 86400) + 3.0f * (float)sin(seconds * 2 * M_PI / 11000) + noise;
+}
+
+int main(void)
+{
+    holdover_model_t m;
+    holdover_model_init(&m);
+    uint32_t seed = 1;
+    const double step = 60;
+
+    // Learning: 3 days with an NTP update every hour, 2 ms NTP jitter
+    double trueTime = 0, timer = 0;
+    double spanTrue = 0, spanTimer = 0, tempSum = 0, ppmSum = 0;
+    uint32_t samples = 0, spans = 0;
+    for (double t = 0; t < 3 * 86400; t += step)
+    {
+        float temp = sim_temperature(t, &seed);
+        tempSum += temp;
+        samples++;
+        trueTime += step;
+        timer += step * (1 + sim_crystal_ppm(temp) * 1e-6);
+
+        if (fmod(trueTime, 3600) == 0)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            double jitter = ((seed >> 8) / 16777216.0 - 0.5) * 0.004;
+            double ntpElapsed = trueTime + jitter - spanTrue;
+            double ppm = (timer - spanTimer - ntpElapsed) * 1e6 / ntpElapsed;
+            holdover_model_learn(&m, (float)(tempSum / samples), (float)ppm);
+            ppmSum += ppm;
+            spans++;
+            spanTrue = trueTime + jitter;
+            spanTimer = timer;
+            tempSum = 0;
+            samples = 0;
+        }
+    }
+    printf("Holdover model: %u bins %.1f..%.1f C, ppm = %.3f %+.4f x %+.5f x^2\n",
+           m.bins, m.t_min, m.t_max, m.a, m.b, m.c);
+
+    // Holdover: 24 h without NTP. Uncompensated, mean rate only (what a plain frequency
+    // estimate would give) and temperature compensated.
+    double errorRaw = 0, errorMean = 0, errorModel = 0;
+    double maxRaw = 0, maxMean = 0, maxModel = 0;
+    float meanPpm = (float)(ppmSum / spans);
+    for (double t = 3 * 86400; t < 4 * 86400; t += step)
+    {
+        float temp = sim_temperature(t, &seed);
+        float actual = sim_crystal_ppm(temp);
+        float predicted = 0;
+        holdover_model_predict(&m, temp, &predicted);
+
+        errorRaw += step * actual * 1e-6;
+        errorMean += step * (actual - meanPpm) * 1e-6;
+        errorModel += step * (actual - predicted) * 1e-6;
+        maxRaw = fmax(maxRaw, fabs(errorRaw));
+        maxMean = fmax(maxMean, fabs(errorMean));
+        maxModel = fmax(maxModel, fabs(errorModel));
+    }
+    printf("Holdover 24 h max error: uncompensated %.1f ms, mean rate %.1f ms, temperature model %.1f ms\n",
+           maxRaw * 1000, maxMean * 1000, maxModel * 1000);
+
+    CHECK(maxModel < maxMean);
+    CHECK(maxModel < maxRaw);
+
+    return check_result();
+}
@@ -0,0 +1,21 @@
+/* hardware/clocks.h
+ *
+ * Host stand-in for the SDK header, only what the PIO program init needs.
+ */
+#pragma once
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum clock_index {
+    clk_sys = 5
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clk_index) { (void)clk_index; return 125000000; }
+
+#ifdef __cplusplus
+}
+#endif
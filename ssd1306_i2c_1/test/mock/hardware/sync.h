@@ -0,0 +1,27 @@
+/* hardware/sync.h
+ *
+ * Host stand-in for the SDK header. The tests run on one thread, interrupts and spin locks are no-ops.
+ */
+#pragma once
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef volatile uint32_t spin_lock_t;
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+static inline void __dmb(void) { __sync_synchronize(); }
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+int spin_lock_claim_unused(bool required);
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock) { (void)lock; return 0; }
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) { (void)lock; (void)saved_irq; }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,29 @@
+/* hardware/watchdog.h
+ *
+ * Host stand-in for the SDK header. The scratch registers keep their values over a mocked reset,
+ * see mock_watchdog_fire() and mock_watchdog_reboot() in mock_hardware.h.
+ */
+#pragma once
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    volatile uint32_t scratch[8];
+} watchdog_hw_t;
+
+extern watchdog_hw_t mock_watchdog_hw;
+
+#define watchdog_hw (&mock_watchdog_hw)
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update(void);
+bool watchdog_caused_reboot(void);
+bool watchdog_enable_caused_reboot(void);
+
+#ifdef __cplusplus
+}
+#endif
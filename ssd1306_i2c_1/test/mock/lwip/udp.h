@@ -0,0 +1,43 @@
+/* lwip/udp.h
+ *
+ * Host stand-in for the lwIP header, IPv4 only. Datagrams are delivered and sent through
+ * mock_lwip.h instead of a network interface.
+ */
+#pragma once
+
+#include "lwip/pbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    u32_t addr;
+} ip_addr_t;
+
+#define IPADDR_TYPE_V4 0
+#define IPADDR_TYPE_ANY 46
+
+extern const ip_addr_t ip_addr_any;
+#define IP_ANY_TYPE (&ip_addr_any)
+
+struct udp_pcb;
+
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+
+struct udp_pcb {
+    struct udp_pcb *next;
+    u16_t local_port;
+    udp_recv_fn recv;
+    void *recv_arg;
+};
+
+struct udp_pcb *udp_new_ip_type(u8_t type);
+void udp_remove(struct udp_pcb *pcb);
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg);
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port);
+
+#ifdef __cplusplus
+}
+#endif
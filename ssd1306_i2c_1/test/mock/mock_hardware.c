@@ -0,0 +1,394 @@
+/* mock_hardware.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/time.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "hardware/watchdog.h"
+#include "mock_hardware.h"
+
+#define PIO_INSTRUCTIONS 32
+#define SM_QUEUE 4096       // Words pushed while the state machine is stopped
+#define SPIN_LOCKS 32
+
+pio_hw_t mock_pio_hw[NUM_PIOS];
+dma_hw_t mock_dma_hw;
+watchdog_hw_t mock_watchdog_hw;
+
+typedef struct {
+    bool claimed;
+    bool enabled;
+    uint out_bits;
+    uint64_t line_free_ns;      // End of the last scheduled word
+    uint64_t last_start_ns;     // The FIFO is empty once this word went to the shift register
+    uint32_t queue[SM_QUEUE];
+    uint queued;
+} sm_state_t;
+
+static uint64_t nowNs;
+static sm_state_t sms[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+static uint programUsed[NUM_PIOS];
+static uint32_t dmaClaimed;     // Bit per channel
+static spin_lock_t spinLocks[SPIN_LOCKS];
+static uint spinLocksClaimed;
+
+static uint64_t watchdogTimeoutNs;     // 0 while the watchdog is off
+static uint64_t watchdogFedNs;
+static enum { RESET_POWER_ON, RESET_TIMEOUT, RESET_REBOOT } resetReason;
+
+static mock_pio_line_hook_t lineHook;
+static void *lineContext;
+
+void mock_hardware_reset(void)
+{
+    nowNs = 0;
+    memset(mock_pio_hw, 0, sizeof(mock_pio_hw));
+    memset(&mock_dma_hw, 0, sizeof(mock_dma_hw));
+    memset(sms, 0, sizeof(sms));
+    memset(programUsed, 0, sizeof(programUsed));
+    dmaClaimed = 0;
+    spinLocksClaimed = 0;
+    memset((void *)&mock_watchdog_hw, 0, sizeof(mock_watchdog_hw));
+    watchdogTimeoutNs = 0;
+    resetReason = RESET_POWER_ON;
+}
+
+//----------------------------------------------------------------------------------------
+// Time
+
+uint64_t mock_time_ns(void)
+{
+    return nowNs;
+}
+
+void mock_time_advance_us(uint64_t us)
+{
+    nowNs += us * 1000;
+}
+
+uint64_t time_us_64(void)
+{
+    return nowNs / 1000;
+}
+
+void tight_loop_contents(void)
+{
+    nowNs += 1000;
+}
+
+void sleep_us(uint64_t us)
+{
+    mock_time_advance_us(us);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    mock_time_advance_us((uint64_t)ms * 1000);
+}
+
+spin_lock_t *spin_lock_instance(uint lock_num)
+{
+    return &spinLocks[lock_num % SPIN_LOCKS];
+}
+
+int spin_lock_claim_unused(bool required)
+{
+    if (spinLocksClaimed >= SPIN_LOCKS)
+    {
+        if (required)
+        {
+            fprintf(stderr, "mock: no spin lock left\n");
+            abort();
+        }
+        return -1;
+    }
+    return (int)spinLocksClaimed++;
+}
+
+//----------------------------------------------------------------------------------------
+// Watchdog
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug)
+{
+    (void)pause_on_debug;
+    watchdogTimeoutNs = (uint64_t)delay_ms * 1000000;
+    watchdogFedNs = nowNs;
+    mock_watchdog_hw.scratch[4] = 0x6ab73121;   // Same magic as the SDK, tells a timeout from a reboot
+}
+
+void watchdog_update(void)
+{
+    watchdogFedNs = nowNs;
+}
+
+bool watchdog_caused_reboot(void)
+{
+    return resetReason != RESET_POWER_ON;
+}
+
+bool watchdog_enable_caused_reboot(void)
+{
+    return resetReason == RESET_TIMEOUT && mock_watchdog_hw.scratch[4] == 0x6ab73121;
+}
+
+uint64_t mock_watchdog_fire(void)
+{
+    if (!watchdogTimeoutNs)
+    {
+        fprintf(stderr, "mock: watchdog not enabled\n");
+        abort();
+    }
+    uint64_t resetUs = (watchdogFedNs + watchdogTimeoutNs) / 1000;
+    nowNs = 0;
+    watchdogTimeoutNs = 0;
+    resetReason = RESET_TIMEOUT;
+    return resetUs;
+}
+
+void mock_watchdog_reboot(void)
+{
+    nowNs = 0;
+    watchdogTimeoutNs = 0;
+    mock_watchdog_hw.scratch[4] = 0;
+    resetReason = RESET_REBOOT;
+}
+
+//----------------------------------------------------------------------------------------
+// PIO
+
+void mock_pio_set_line_hook(mock_pio_line_hook_t hook, void *context)
+{
+    lineContext = context;
+    lineHook = hook;
+}
+
+static sm_state_t *state(PIO pio, uint sm)
+{
+    return &sms[pio_get_index(pio)][sm % NUM_PIO_STATE_MACHINES];
+}
+
+// The word starts as soon as the line is free, the shift register then holds it for bits bit times
+static void schedule(PIO pio, uint sm, uint32_t word)
+{
+    sm_state_t *s = state(pio, sm);
+    uint64_t start = s->line_free_ns > nowNs ? s->line_free_ns : nowNs;
+    s->last_start_ns = start;
+    s->line_free_ns = start + (uint64_t)s->out_bits * MOCK_PIO_BIT_NS;
+    if (lineHook)
+    {
+        lineHook(pio_get_index(pio), sm, word, s->out_bits, start, lineContext);
+    }
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program)
+{
+    return programUsed[pio_get_index(pio)] + program->length <= PIO_INSTRUCTIONS;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program)
+{
+    if (!pio_can_add_program(pio, program))
+    {
+        fprintf(stderr, "mock: no program space left in PIO%u\n", pio_get_index(pio));
+        abort();
+    }
+    uint offset = programUsed[pio_get_index(pio)];
+    programUsed[pio_get_index(pio)] += program->length;
+    return offset;
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config)
+{
+    (void)initial_pc;
+    sm_state_t *s = state(pio, sm);
+    s->enabled = false;
+    s->queued = 0;
+    s->out_bits = config->out_bits;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+    sm_state_t *s = state(pio, sm);
+    s->enabled = enabled;
+    if (enabled)
+    {
+        for (uint i = 0; i < s->queued; i++)
+        {
+            schedule(pio, sm, s->queue[i]);
+        }
+        s->queued = 0;
+    }
+}
+
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled)
+{
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++)
+    {
+        if (mask & (1u << sm))
+        {
+            pio_sm_set_enabled(pio, sm, enabled);
+        }
+    }
+}
+
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask)
+{
+    pio_set_sm_mask_enabled(pio, mask, true);
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data)
+{
+    sm_state_t *s = state(pio, sm);
+    if (s->enabled)
+    {
+        schedule(pio, sm, data);
+    }
+    else if (s->queued < SM_QUEUE)
+    {
+        s->queue[s->queued++] = data;
+    }
+    else
+    {
+        // A real FIFO would block forever
+        fprintf(stderr, "mock: PIO%u SM%u is stopped and its FIFO is full\n", pio_get_index(pio), sm);
+        abort();
+    }
+}
+
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm)
+{
+    sm_state_t *s = state(pio, sm);
+    return s->queued == 0 && nowNs >= s->last_start_ns;
+}
+
+void pio_sm_claim(PIO pio, uint sm)
+{
+    state(pio, sm)->claimed = true;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++)
+    {
+        if (!state(pio, sm)->claimed)
+        {
+            state(pio, sm)->claimed = true;
+            return (int)sm;
+        }
+    }
+    if (required)
+    {
+        fprintf(stderr, "mock: no free state machine in PIO%u\n", pio_get_index(pio));
+        abort();
+    }
+    return -1;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm)
+{
+    state(pio, sm)->claimed = false;
+}
+
+bool pio_sm_is_claimed(PIO pio, uint sm)
+{
+    return state(pio, sm)->claimed;
+}
+
+//----------------------------------------------------------------------------------------
+// DMA
+
+int dma_claim_unused_channel(bool required)
+{
+    for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++)
+    {
+        if (!(dmaClaimed & (1u << channel)))
+        {
+            dmaClaimed |= 1u << channel;
+            return (int)channel;
+        }
+    }
+    if (required)
+    {
+        fprintf(stderr, "mock: no DMA channel left\n");
+        abort();
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+    dmaClaimed &= ~(1u << channel);
+}
+
+bool dma_channel_is_claimed(uint channel)
+{
+    return (dmaClaimed & (1u << channel)) != 0;
+}
+
+static bool find_fifo(volatile void *addr, PIO *pio, uint *sm)
+{
+    for (uint i = 0; i < NUM_PIOS; i++)
+    {
+        for (uint j = 0; j < NUM_PIO_STATE_MACHINES; j++)
+        {
+            if (addr == (volatile void *)&mock_pio_hw[i].txf[j])
+            {
+                *pio = &mock_pio_hw[i];
+                *sm = j;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+    dma_hw->ch[channel].transfer_count = transfer_count;
+    if (!trigger)
+    {
+        return;
+    }
+
+    uint size = 1u << config->size;
+    uintptr_t ringMask = (config->ring_bits && !config->ring_write) ? ((uintptr_t)1 << config->ring_bits) - 1 : ~(uintptr_t)0;
+    PIO pio = NULL;
+    uint sm = 0;
+    bool toPio = find_fifo(write_addr, &pio, &sm);
+
+    for (uint i = 0; i < transfer_count; i++)
+    {
+        uintptr_t from = (uintptr_t)read_addr;
+        from = (from & ~ringMask) | ((from + (config->read_increment ? i * size : 0)) & ringMask);
+        uint32_t value;
+        // Narrow transfers are replicated over the bus lanes, as on the RP2040
+        switch (size)
+        {
+            case 1:
+                value = *(const volatile uint8_t *)from * 0x01010101u;
+                break;
+            case 2:
+                value = *(const volatile uint16_t *)from * 0x00010001u;
+                break;
+            default:
+                value = *(const volatile uint32_t *)from;
+                break;
+        }
+
+        if (toPio)
+        {
+            pio_sm_put_blocking(pio, sm, value);
+        }
+        else
+        {
+            volatile uint8_t *to = (volatile uint8_t *)write_addr + (config->write_increment ? i * size : 0);
+            memcpy((void *)to, &value, size);
+        }
+        dma_hw->ch[channel].transfer_count = transfer_count - i - 1;
+    }
+}
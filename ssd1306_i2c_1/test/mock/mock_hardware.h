@@ -0,0 +1,53 @@
+/* mock_hardware.h
+ *
+ * Controls of the mocked SDK for the host tests.
+ *
+ * Time is virtual: it only moves when a test advances it or when code busy waits in tight_loop_contents()
+ * (1 µs per call), so the results do not depend on the speed of the host.
+ * Every word a PIO state machine pulls from its TX FIFO goes out on a virtual line at 800 kHz. A word is
+ * scheduled when it is pushed into the FIFO of a running state machine, or when a stopped one is started,
+ * and then starts as soon as the line is free.
+ */
+#pragma once
+
+#include <time.h>
+
+#include "pico/types.h"
+#include "hardware/pio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOCK_PIO_BIT_NS 1250        // WS2812 bit time at 800 kHz
+
+// Power-on: resets the clock, the PIO blocks, the DMA channels and the watchdog
+void mock_hardware_reset(void);
+
+uint64_t mock_time_ns(void);
+void mock_time_advance_us(uint64_t us);
+
+// Real time of the host, for the benchmarks
+static inline uint64_t host_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// Watchdog reset after a hang: the time moves on to the timeout after the last watchdog_update(),
+// then the timer starts again from 0. Returns the timer value of the reset.
+uint64_t mock_watchdog_fire(void);
+
+// Reset by watchdog_reboot(), right now
+void mock_watchdog_reboot(void);
+
+// Called for every word shifted out on a line: the bits are the MSBs of word, the line
+// is busy from startNs for bits * MOCK_PIO_BIT_NS
+typedef void (*mock_pio_line_hook_t)(uint pioIndex, uint sm, uint32_t word, uint bits, uint64_t startNs, void *context);
+
+void mock_pio_set_line_hook(mock_pio_line_hook_t hook, void *context);
+
+#ifdef __cplusplus
+}
+#endif
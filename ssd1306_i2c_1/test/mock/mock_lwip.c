@@ -0,0 +1,164 @@
+/* mock_lwip.c
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "mock_lwip.h"
+
+#define UDP_HLEN 8
+#define IP_HLEN 20
+
+const ip_addr_t ip_addr_any = { 0 };
+
+static struct udp_pcb *pcbs;
+static int pbufs;
+
+static mock_udp_send_hook_t sendHook;
+static void *sendContext;
+
+//----------------------------------------------------------------------------------------
+// pbuf
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type)
+{
+    (void)type;
+    struct pbuf *p = calloc(1, sizeof(struct pbuf) + layer + length);
+    if (!p)
+        return NULL;
+    p->buffer = (u8_t *)(p + 1);
+    p->payload = p->buffer + layer;
+    p->tot_len = length;
+    p->len = length;
+    p->ref = 1;
+    pbufs++;
+    return p;
+}
+
+u8_t pbuf_free(struct pbuf *p)
+{
+    if (!p || --p->ref > 0)
+        return 0;
+    free(p);
+    pbufs--;
+    return 1;
+}
+
+void pbuf_ref(struct pbuf *p)
+{
+    p->ref++;
+}
+
+u8_t pbuf_add_header(struct pbuf *p, size_t header_size_increment)
+{
+    if ((size_t)((u8_t *)p->payload - p->buffer) < header_size_increment)
+        return 1;
+    p->payload = (u8_t *)p->payload - header_size_increment;
+    p->tot_len += header_size_increment;
+    p->len += header_size_increment;
+    return 0;
+}
+
+u8_t pbuf_remove_header(struct pbuf *p, size_t header_size_decrement)
+{
+    if (header_size_decrement > p->len)
+        return 1;
+    p->payload = (u8_t *)p->payload + header_size_decrement;
+    p->tot_len -= header_size_decrement;
+    p->len -= header_size_decrement;
+    return 0;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset)
+{
+    if (offset >= p->len)
+        return 0;
+    u16_t n = p->len - offset < len ? p->len - offset : len;
+    memcpy(dataptr, (const u8_t *)p->payload + offset, n);
+    return n;
+}
+
+int mock_pbuf_count(void)
+{
+    return pbufs;
+}
+
+//----------------------------------------------------------------------------------------
+// UDP
+
+struct udp_pcb *udp_new_ip_type(u8_t type)
+{
+    (void)type;
+    return calloc(1, sizeof(struct udp_pcb));
+}
+
+void udp_remove(struct udp_pcb *pcb)
+{
+    for (struct udp_pcb **p = &pcbs; *p; p = &(*p)->next)
+    {
+        if (*p == pcb)
+        {
+            *p = pcb->next;
+            break;
+        }
+    }
+    free(pcb);
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
+{
+    (void)ipaddr;
+    for (struct udp_pcb *p = pcbs; p; p = p->next)
+    {
+        if (p != pcb && port && p->local_port == port)
+            return ERR_USE;
+    }
+    pcb->local_port = port;
+    pcb->next = pcbs;
+    pcbs = pcb;
+    return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg)
+{
+    pcb->recv = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+// The headers go in front of the payload and stay there, the frame is on the air right away
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port)
+{
+    (void)pcb;
+    if (pbuf_add_header(p, UDP_HLEN + IP_HLEN))
+        return ERR_BUF;
+    if (sendHook)
+    {
+        sendHook((const u8_t *)p->payload + UDP_HLEN + IP_HLEN, p->len - UDP_HLEN - IP_HLEN, dst_ip, dst_port, sendContext);
+    }
+    return ERR_OK;
+}
+
+void mock_udp_set_send_hook(mock_udp_send_hook_t hook, void *context)
+{
+    sendContext = context;
+    sendHook = hook;
+}
+
+bool mock_udp_deliver(u16_t port, const void *data, u16_t len, const ip_addr_t *from, u16_t fromPort)
+{
+    for (struct udp_pcb *pcb = pcbs; pcb; pcb = pcb->next)
+    {
+        if (pcb->local_port == port && pcb->recv)
+        {
+            struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+            if (!p)
+                return false;
+            memcpy(p->payload, data, len);
+            // The callback owns the pbuf
+            pcb->recv(pcb->recv_arg, pcb, p, from, fromPort);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,31 @@
+/* mock_lwip.h
+ *
+ * Controls of the mocked lwIP for the host tests. There is no network: the test delivers datagrams
+ * to a bound port and sees every udp_sendto() in a hook. Sending adds the UDP and IP headers in
+ * the headroom of the pbuf, as lwIP does, and the frame leaves right away.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "lwip/udp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Receives a datagram on the pcb bound to port, like lwIP would from the driver.
+// Returns false when nobody listens on the port.
+bool mock_udp_deliver(u16_t port, const void *data, u16_t len, const ip_addr_t *from, u16_t fromPort);
+
+// Called for every udp_sendto() with the datagram payload
+typedef void (*mock_udp_send_hook_t)(const void *data, u16_t len, const ip_addr_t *to, u16_t port, void *context);
+
+void mock_udp_set_send_hook(mock_udp_send_hook_t hook, void *context);
+
+// Number of pbufs allocated and not yet freed
+int mock_pbuf_count(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+/* pico/platform.h
+ *
+ * Host stand-in for the SDK header. Variables in RAM that is not cleared at boot are plain statics,
+ * they keep their values over a mocked reset anyway.
+ */
+#pragma once
+
+#include "pico/types.h"
+
+#define __uninitialized_ram(group) group
@@ -0,0 +1,19 @@
+/* pico/time.h
+ *
+ * Host stand-in for the SDK header. The timer is the virtual clock of mock_hardware.c.
+ */
+#pragma once
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t time_us_64(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
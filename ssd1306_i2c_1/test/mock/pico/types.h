@@ -0,0 +1,31 @@
+/* pico/types.h
+ *
+ * Host stand-in for the SDK header: the integer types and helper macros the modules use.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+
+#ifndef MIN
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+// Busy waits advance the virtual clock, see mock_hardware.h
+void tight_loop_contents(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+// Throughput of the pixel pipeline on the host: drawing, brightness table and show() into the mocked
+// PIO, compared with the time the frames need on the wire (virtual clock, see mock_hardware.h).
+// The CPU figures are the host's, they rank the paths against each other, not against the RP2040.
+#include <stdio.h>
+
+#include <chrono>
+
+#include "LedOutputs.hpp"
+#include "ClockFace.hpp"
+#include "pixel_kernels.h"
+#include "pico/time.h"
+#include "mock_hardware.h"
+
+static const uint LENGTH = ClockFace::RING_LEDS;
+static const uint FRAMES = 20000;
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedUs(Clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+static void report(const char *name, uint frames, double cpuUs, uint64_t virtualUs, uint wireUs) {
+    printf("%-22s %6u frames  cpu %7.3f us/frame  line %6.1f us/frame (wire model %u us)  %7.0f frames/s on the wire\n",
+           name, frames, cpuUs / frames, (double)virtualUs / frames, wireUs, frames * 1e6 / virtualUs);
+}
+
+static void benchmarkDraw(const char *name, WS2812::Storage storage) {
+    mock_hardware_reset();
+    WS2812 strip(14, LENGTH, pio0, 0, WS2812::FORMAT_GRB, storage);
+    uint8_t lut[256];
+    pixel_lut_build(lut, 128, 2.2f);
+    strip.setLut(lut);
+
+    uint64_t virtualStart = time_us_64();
+    Clock::time_point start = Clock::now();
+    for (uint f = 0; f < FRAMES; f++) {
+        for (uint i = 0; i < LENGTH; i++) {
+            strip.setPixelColor(i, WS2812::RGB((uint8_t)(f + i), (uint8_t)(f * 3), (uint8_t)i));
+        }
+        strip.show();
+    }
+    double cpuUs = elapsedUs(start);
+    report(name, strip.getShowCount(), cpuUs, time_us_64() - virtualStart, strip.getWireTimeUs());
+}
+
+// The clock face: both rings from flash through LedOutputs, every position in turn
+static void benchmarkClockFace() {
+    static const LedOutputs::Config config[] = {
+        { 14, LENGTH, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED },
+        { 15, LENGTH, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED },
+    };
+    mock_hardware_reset();
+    LedOutputs leds(config, count_of(config));
+    leds.begin();
+
+    uint64_t virtualStart = time_us_64();
+    Clock::time_point start = Clock::now();
+    uint shows = 0;
+    for (uint f = 0; f < FRAMES; f++) {
+        uint minutes = f % 720;
+        const uint8_t *frames[] = { ClockFace::outer(minutes % 60), ClockFace::inner(minutes / 60, minutes % 60) };
+        leds.show(frames);
+        shows++;
+    }
+    leds.strip(0).waitIdle();
+    leds.strip(1).waitIdle();
+    double cpuUs = elapsedUs(start);
+    report("clock face (2 rings)", shows, cpuUs, time_us_64() - virtualStart, leds.strip(0).getWireTimeUs());
+    printf("%-22s %u outer and %u inner frames pushed, %u and %u skipped as unchanged\n", "",
+           leds.strip(0).getShowCount(), leds.strip(1).getShowCount(),
+           leds.strip(0).getSkippedShowCount(), leds.strip(1).getSkippedShowCount());
+}
+
+int main() {
+    benchmarkDraw("word storage", WS2812::STORAGE_WORD);
+    benchmarkDraw("packed storage", WS2812::STORAGE_PACKED);
+    benchmarkClockFace();
+    return 0;
+}
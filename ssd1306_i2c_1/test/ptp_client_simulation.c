@@ -0,0 +1,216 @@
+/* ptp_client_simulation.c
+ *
+ * Runs a software grandmaster against the protocol and the clock discipline for six hours of
+ * synthetic Wi-Fi delays, next to NTP over the same Wi-Fi, and prints the offsets that the slave
+ * achieves. Over the last three hours PTP must hold the clock closer than NTP does.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "clock_discipline.h"
+#include "ptp_message.h"
+#include "ntp_packet.h"
+#include "ntp_select.h"
+#include "ptp_client.h"
+#include "check.h"
+
+#define SIM_EPOCH_US (1767225600ll * 1000000)   // 2026-01-01
+
+static double sim_random(uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return ((*seed >> 8) + 1) / 16777217.0;
+}
+
+// One way through Wi-Fi: air time, queueing, now and then a frame held until the next DTIM
+static double sim_wifi_delay(uint32_t *seed)
+{
+    double delay = 0.0008 - 0.0015 * log(sim_random(seed));
+    if (sim_random(seed) < 0.1)
+    {
+        delay += 0.1 * sim_random(seed);
+    }
+    return delay;
+}
+
+// Local clock disciplined by one of the protocols, times in s
+typedef struct {
+    clock_discipline_t d;
+    double offset;              // True - local
+    int64_t corrected;          // µs, as clock_discipline_correction_us()
+    double last_update;
+    bool locked;
+    double sum_sq, max_abs;
+    uint32_t samples;
+} sim_clock_t;
+
+static void sim_clock_init(sim_clock_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    clock_discipline_init(&c->d);
+    c->offset = -0.05;          // Starts 50 ms ahead
+}
+
+static void sim_clock_advance(sim_clock_t *c, double ppm, double step, bool measure)
+{
+    c->offset -= step * (ppm * 1e-6 + clock_discipline_rate_ppb(&c->d) * 1e-9);
+    int64_t phase = c->d.phase_us;
+    clock_discipline_advance(&c->d, (uint64_t)(step * 1e6));
+    c->corrected += phase - c->d.phase_us;
+
+    if (measure)
+    {
+        c->sum_sq += c->offset * c->offset;
+        c->max_abs = fmax(c->max_abs, fabs(c->offset));
+        c->samples++;
+    }
+}
+
+// Offset with the corrections until now removed, as the services hand it on
+static void sim_clock_update(sim_clock_t *c, int64_t offsetUs, double t)
+{
+    uint32_t interval = c->locked ? (uint32_t)(t - c->last_update) : 0;
+    if (!clock_discipline_update(&c->d, offsetUs, interval))
+    {
+        c->offset -= offsetUs * 1e-6;
+        c->corrected += offsetUs;
+    }
+    c->last_update = t;
+    c->locked = true;
+}
+
+// Local clock at true time t, µs
+static int64_t sim_local_us(const sim_clock_t *c, double t)
+{
+    return SIM_EPOCH_US + (int64_t)((t - c->offset) * 1e6);
+}
+
+// A two-step grandmaster at true time t, all messages through the wire format.
+// Returns false when the exchange failed.
+static bool sim_ptp_exchange(sim_clock_t *c, double t, uint16_t sequence, uint32_t *seed, int64_t *offset, int64_t *delay)
+{
+    ptp_port_identity_t gm = { { 0x00, 0x1b, 0x19, 0xff, 0xfe, 0x00, 0x00, 0x01 }, 1 };
+    ptp_port_identity_t slave = { { 0x28, 0xcd, 0xc1, 0xff, 0xfe, 0x00, 0x00, 0x02 }, 1 };
+    uint8_t buf[PTP_MAX_LEN];
+    ptp_message_t m, sync, followUp, delayResp;
+
+    memset(&m, 0, sizeof(m));
+    m.type = PTP_SYNC;
+    m.flags = PTP_FLAG_TWO_STEP | PTP_FLAG_PTP_TIMESCALE;
+    m.source = gm;
+    m.sequence = sequence;
+    if (!ptp_message_decode(&sync, buf, ptp_message_encode(&m, buf)))
+        return false;
+    double arrival = t + sim_wifi_delay(seed);
+    int64_t t2 = sim_local_us(c, arrival) - c->corrected;
+
+    m.type = PTP_FOLLOW_UP;
+    m.timestamp_ns = ptp_from_unix_us(SIM_EPOCH_US + (int64_t)(t * 1e6), PTP_DEFAULT_UTC_OFFSET);
+    if (!ptp_message_decode(&followUp, buf, ptp_message_encode(&m, buf)) || followUp.sequence != sync.sequence)
+        return false;
+    int64_t t1 = ptp_to_unix_us(followUp.timestamp_ns + sync.correction_ns + followUp.correction_ns, PTP_DEFAULT_UTC_OFFSET);
+
+    // Delay_Req leaves 200 µs later from the lwIP callback
+    double sent = arrival + 0.0002;
+    int64_t t3 = sim_local_us(c, sent) - c->corrected;
+    m.type = PTP_DELAY_RESP;
+    m.timestamp_ns = ptp_from_unix_us(SIM_EPOCH_US + (int64_t)((sent + sim_wifi_delay(seed)) * 1e6), PTP_DEFAULT_UTC_OFFSET);
+    m.requesting = slave;
+    if (!ptp_message_decode(&delayResp, buf, ptp_message_encode(&m, buf)) || !ptp_port_equal(&delayResp.requesting, &slave))
+        return false;
+    int64_t t4 = ptp_to_unix_us(delayResp.timestamp_ns - delayResp.correction_ns, PTP_DEFAULT_UTC_OFFSET);
+
+    ptp_offset(t1, t2, t3, t4, offset, delay);
+    return true;
+}
+
+int main(void)
+{
+    sim_clock_t ptp, ntp;
+    sim_clock_init(&ptp);
+    sim_clock_init(&ntp);
+    ntp_filter_t filter;
+    ntp_filter_init(&filter);
+    uint32_t seed = 7, walkSeed = 11;
+    const double hours = 6;
+
+    // Same oscillator as the discipline simulation, the same Wi-Fi under both protocols.
+    // The NTP server is further away: 4 ms each way over the Internet, 1 ms asymmetry.
+    double walk = 0;
+    double nextNtp = 0;
+    uint32_t windowCount = 0, exchanges = 0, failed = 0;
+    double windowStart = 0;
+    int64_t bestOffset = 0, bestDelay = 0;
+
+    printf("PTP vs NTP:   hour  PTP offset ms  poll s  NTP offset ms  poll s\n");
+    for (double t = 0; t < hours * 3600; t += 1)
+    {
+        double u1 = sim_random(&walkSeed), u2 = sim_random(&walkSeed);
+        walk += sqrt(-2 * log(u1)) * cos(2 * M_PI * u2) * 0.0006;
+        double ppm = 12 + 2 * sin(t * 2 * M_PI / 86400) + walk;
+        bool measure = t >= hours * 3600 / 2;
+        sim_clock_advance(&ptp, ppm, 1, measure);
+        sim_clock_advance(&ntp, ppm, 1, measure);
+
+        // PTP: one Sync per second, the shortest path delay of a poll interval
+        int64_t offset, delay;
+        if (sim_ptp_exchange(&ptp, t, (uint16_t)t, &seed, &offset, &delay))
+        {
+            exchanges++;
+            if (!windowCount || delay < bestDelay)
+            {
+                bestOffset = offset;
+                bestDelay = delay;
+            }
+            if (!windowCount++)
+            {
+                windowStart = t;
+            }
+        }
+        else
+        {
+            failed++;
+        }
+        if (windowCount && (ptp.locked ? t - windowStart >= (1u << ptp.d.poll) : windowCount >= PTP_CLIENT_FIRST))
+        {
+            sim_clock_update(&ptp, bestOffset - ptp.corrected, t);
+            windowCount = 0;
+        }
+
+        // NTP: one exchange per poll through the 8 sample filter
+        if (t >= nextNtp)
+        {
+            double up = sim_wifi_delay(&seed) + 0.0045 - 0.001 * log(sim_random(&seed));
+            double down = sim_wifi_delay(&seed) + 0.0035 - 0.001 * log(sim_random(&seed));
+            int64_t serverUs = SIM_EPOCH_US + (int64_t)((t + up) * 1e6);
+            ntp_on_wire(sim_local_us(&ntp, t), serverUs, serverUs + 50, sim_local_us(&ntp, t + up + 0.00005 + down),
+                        &offset, &delay);
+
+            ntp_sample_t sample = { offset + ntp.corrected, (uint64_t)(t * 1e6), (uint32_t)delay, 1000 };
+            ntp_filter_add(&filter, &sample);
+            ntp_estimate_t estimate;
+            if (ntp_filter_estimate(&filter, ntp.corrected, (uint64_t)(t * 1e6), &estimate))
+            {
+                sim_clock_update(&ntp, estimate.offset_us, t);
+            }
+            nextNtp = t + (1u << ntp.d.poll);
+        }
+
+        if (fmod(t, 3600) == 0)
+        {
+            printf("PTP vs NTP: %6.0f  %13.3f  %6u  %13.3f  %6u\n", t / 3600, ptp.offset * 1000, 1u << ptp.d.poll,
+                   ntp.offset * 1000, 1u << ntp.d.poll);
+        }
+    }
+    printf("PTP: %u exchanges, %u failed; last %.0f hours RMS offset %.3f ms, max %.3f ms\n", exchanges, failed,
+           hours / 2, sqrt(ptp.sum_sq / ptp.samples) * 1000, ptp.max_abs * 1000);
+    printf("NTP: last %.0f hours RMS offset %.3f ms, max %.3f ms\n", hours / 2,
+           sqrt(ntp.sum_sq / ntp.samples) * 1000, ntp.max_abs * 1000);
+
+    CHECK(failed == 0);
+    CHECK(sqrt(ptp.sum_sq / ptp.samples) < sqrt(ntp.sum_sq / ntp.samples));
+    CHECK(sqrt(ptp.sum_sq / ptp.samples) < 0.001);
+
+    return check_result();
+}
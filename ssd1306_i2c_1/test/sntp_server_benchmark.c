@@ -0,0 +1,141 @@
+/* sntp_server_benchmark.c
+ *
+ * Stand-in client: sends requests to UDP port 123 of the mocked lwIP, through the server's udp_recv
+ * callback and reply pool, and checks every reply. Prints replies per second of the host.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/time.h"
+#include "timekeeping.h"
+#include "time_source.h"
+#include "ntp_packet.h"
+#include "ntp_client.h"
+#include "sntp_server.h"
+#include "mock_hardware.h"
+#include "mock_lwip.h"
+#include "check.h"
+
+#define EPOCH_US (1767225600ll * 1000000)   // 2026-01-01
+#define CLOCK_ERROR_US 2000
+#define REFERENCE_ID 0xc0a80001u            // 192.168.0.1
+
+// The server asks the NTP client for stratum and reference, ntp_client.c is not part of the host build
+static ntp_client_status_t clientStatus;
+
+void ntp_client_status(ntp_client_status_t *status)
+{
+    *status = clientStatus;
+}
+
+static time_source_t ntp = { "NTP", NULL, NULL, NULL };
+
+typedef struct {
+    uint32_t replies;
+    ntp_packet_t last;
+} client_t;
+
+static void on_send(const void *data, u16_t len, const ip_addr_t *to, u16_t port, void *context)
+{
+    (void)to;
+    (void)port;
+    client_t *c = (client_t *)context;
+    c->replies++;
+    CHECK(len == NTP_PACKET_LEN);
+    ntp_packet_decode(&c->last, (const uint8_t *)data);
+}
+
+static bool request(client_t *c, ntp_timestamp_t transmit, uint8_t mode, u16_t len)
+{
+    ntp_packet_t out;
+    memset(&out, 0, sizeof(out));
+    out.version = 4;
+    out.mode = mode;
+    out.transmit = transmit;
+    uint8_t buf[NTP_PACKET_LEN];
+    ntp_packet_encode(&out, buf);
+
+    static const ip_addr_t from = { 0x0a00a8c0u };
+    uint32_t replies = c->replies;
+    CHECK(mock_udp_deliver(NTP_PORT, buf, len, &from, 50123));
+    return c->replies > replies;
+}
+
+int main(void)
+{
+    const uint32_t count = 200000;
+    client_t client;
+    memset(&client, 0, sizeof(client));
+
+    mock_hardware_reset();
+    timekeeping_init();
+    mock_time_advance_us(5000000);
+    CHECK(time_source_offer(&ntp, EPOCH_US, time_us_64(), CLOCK_ERROR_US));
+    clientStatus.synchronized = true;
+    clientStatus.stratum = 2;
+    clientStatus.reference_id = REFERENCE_ID;
+    clientStatus.root_delay_us = 12000;
+    clientStatus.reference_us = EPOCH_US;
+
+    mock_udp_set_send_hook(on_send, &client);
+    CHECK(sntp_server_init());
+    int pool = mock_pbuf_count();
+
+    uint32_t bad = 0;
+    uint64_t start = host_time_us();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // Every request carries its own transmit timestamp, like a real client
+        mock_time_advance_us(50);
+        ntp_timestamp_t transmit = ntp_timestamp_from_unix_us(timekeeping_realtime_us()) + i;
+        int64_t received = timekeeping_realtime_us();
+        if (!request(&client, transmit, NTP_MODE_CLIENT, NTP_PACKET_LEN))
+        {
+            bad++;
+            continue;
+        }
+
+        ntp_packet_t *server = &client.last;
+        int64_t t2 = ntp_timestamp_to_unix_us(server->receive, received);
+        int64_t t3 = ntp_timestamp_to_unix_us(server->transmit, received);
+        if (server->mode != NTP_MODE_SERVER || server->origin != transmit || t2 != received || t3 < t2)
+        {
+            bad++;
+        }
+    }
+    uint64_t elapsed = host_time_us() - start;
+    printf("SNTP server: %u requests in %llu us, %llu replies/s, %u bad\n", count, (unsigned long long)elapsed,
+           (unsigned long long)(count * 1000000ull / (elapsed ? elapsed : 1)), bad);
+    CHECK(bad == 0);
+
+    // The reply passes on the NTP client's view and the error bound of the clock
+    ntp_packet_t *last = &client.last;
+    CHECK(last->leap == 0);
+    CHECK(last->stratum == 3);
+    CHECK(last->reference_id == REFERENCE_ID);
+    CHECK(llabs((int64_t)ntp_short_to_us(last->root_delay) - 12000) < 20);     // 16.16 rounding
+    CHECK(ntp_short_to_us(last->root_dispersion) >= CLOCK_ERROR_US);
+    CHECK(last->precision == SNTP_SERVER_PRECISION);
+
+    // Only client requests of full length are answered
+    CHECK(!request(&client, 1, NTP_MODE_SERVER, NTP_PACKET_LEN));
+    CHECK(!request(&client, 1, NTP_MODE_CLIENT, NTP_PACKET_LEN - 1));
+
+    // Without NTP the replies say so
+    clientStatus.synchronized = false;
+    CHECK(request(&client, 1, NTP_MODE_CLIENT, NTP_PACKET_LEN));
+    CHECK(client.last.leap == NTP_LEAP_UNSYNCHRONIZED);
+    CHECK(client.last.stratum == 16);
+
+    sntp_server_stats_t stats;
+    sntp_server_stats(&stats);
+    CHECK(stats.requests == count + 3);
+    CHECK(stats.replies == count + 1);
+    CHECK(stats.dropped == 0);
+
+    // Requests are freed, the reply buffers are used again
+    CHECK(mock_pbuf_count() == pool);
+
+    return check_result();
+}
@@ -0,0 +1,184 @@
+/* time_source_test.c
+ *
+ * Source selection with a mock RTC: the RTC sets the clock at boot, NTP replaces it as soon as it
+ * answers, the NTP time is written back to the RTC and the RTC never pulls the NTP set clock back.
+ * An NTP sample that can neither be slewed nor step the clock leaves the clock discipline alone.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/time.h"
+#include "timekeeping.h"
+#include "time_source.h"
+#include "clock_discipline.h"
+#include "mock_hardware.h"
+#include "check.h"
+
+#define EPOCH_US (1767225600ll * 1000000)   // 2026-01-01
+#define RTC_ERROR_US 500000                 // Same bound as ds3231.c
+#define NTP_ERROR_US 15000
+
+//----------------------------------------------------------------------------------------
+// Mock RTC: whole seconds like a DS3231, running ppm fast
+
+typedef struct {
+    int64_t utc_us;         // RTC time at timer_us
+    uint64_t timer_us;
+    int32_t ppm;
+    uint32_t reads;
+    uint32_t writes;
+} mock_rtc_t;
+
+static int64_t mock_rtc_now(const mock_rtc_t *rtc)
+{
+    int64_t elapsed = (int64_t)(time_us_64() - rtc->timer_us);
+    return rtc->utc_us + elapsed + elapsed * rtc->ppm / 1000000;
+}
+
+static bool mock_rtc_read(time_source_t *source, int64_t *utcUs, uint64_t *timerUs, uint32_t *errorUs)
+{
+    mock_rtc_t *rtc = (mock_rtc_t *)source->context;
+    rtc->reads++;
+    // Start of the current second, the true time is anywhere in it
+    int64_t seconds = mock_rtc_now(rtc) / 1000000;
+    *timerUs = time_us_64();
+    *utcUs = seconds * 1000000 + RTC_ERROR_US;
+    *errorUs = RTC_ERROR_US;
+    return true;
+}
+
+// The second restarts when the seconds register is written
+static bool mock_rtc_write(time_source_t *source, int64_t utcSeconds)
+{
+    mock_rtc_t *rtc = (mock_rtc_t *)source->context;
+    rtc->writes++;
+    rtc->utc_us = utcSeconds * 1000000;
+    rtc->timer_us = time_us_64();
+    return true;
+}
+
+static mock_rtc_t rtcState;
+static time_source_t rtc = { "RTC", mock_rtc_read, mock_rtc_write, &rtcState };
+static time_source_t ntp = { "NTP", NULL, NULL, NULL };
+
+//----------------------------------------------------------------------------------------
+
+// An NTP result the way ntp_client.c applies it: slewed when the clock follows NTP and the offset
+// is small, a step when the sample beats the clock. Returns false when it was not used.
+static bool ntp_result(int64_t offsetUs, uint32_t distanceUs)
+{
+    uint64_t now = time_us_64();
+    int64_t utcUs = timekeeping_realtime_at(now) + offsetUs;
+    if (time_source_current() == &ntp && clock_discipline_offset(offsetUs, now))
+    {
+        return time_source_confirm(&ntp, now, distanceUs);
+    }
+    if (time_source_offer(&ntp, utcUs, now, distanceUs))
+    {
+        clock_discipline_step(offsetUs);
+        return true;
+    }
+    return false;
+}
+
+// True time of the test, the timer runs exactly
+static int64_t true_us(void)
+{
+    return EPOCH_US + (int64_t)time_us_64();
+}
+
+static int64_t clock_error_us(void)
+{
+    return llabs(timekeeping_realtime_us() - true_us());
+}
+
+int main(void)
+{
+    mock_hardware_reset();
+    timekeeping_init();
+
+    // The RTC lost 700 ms while the board was off
+    rtcState.utc_us = EPOCH_US - 700000;
+    rtcState.timer_us = 0;
+    rtcState.ppm = 2;
+
+    CHECK(time_source_register(&rtc));
+    CHECK(time_source_register(&ntp));
+    CHECK(time_source_error_us() == UINT32_MAX);
+    CHECK(!timekeeping_is_set());
+
+    // Boot: the RTC is the only source that can be read
+    mock_time_advance_us(2000);
+    CHECK(time_source_poll());
+    CHECK(time_source_current() == &rtc);
+    CHECK(timekeeping_is_set());
+    CHECK(clock_error_us() <= RTC_ERROR_US + 700000);
+    CHECK(llabs(timekeeping_realtime_us() - mock_rtc_now(&rtcState)) <= RTC_ERROR_US);
+    printf("Boot: clock set from the RTC, %lld ms off\n", (long long)(clock_error_us() / 1000));
+
+    // Nothing to write back, the RTC is the source
+    time_source_on_second(timekeeping_realtime_us() / 1000000);
+    CHECK(rtcState.writes == 0);
+
+    // Wi-Fi, DHCP, DNS, then NTP answers
+    mock_time_advance_us(8000000);
+    CHECK(time_source_offer(&ntp, true_us(), time_us_64(), NTP_ERROR_US));
+    CHECK(time_source_current() == &ntp);
+    CHECK(clock_error_us() == 0);
+    CHECK(time_source_error_us() == NTP_ERROR_US);
+    printf("NTP: clock set, error bound %u us\n", (unsigned)time_source_error_us());
+
+    // NTP time goes to the RTC on the next second boundary, once
+    mock_time_advance_us(1000000 - (uint64_t)(true_us() % 1000000));
+    time_source_on_second(timekeeping_realtime_us() / 1000000);
+    CHECK(rtcState.writes == 1);
+    CHECK(llabs(mock_rtc_now(&rtcState) - true_us()) < 1000);
+    time_source_on_second(timekeeping_realtime_us() / 1000000 + 1);
+    CHECK(rtcState.writes == 1);
+
+    // The RTC reads 900 ms off now. Neither right away nor an hour later it may set the clock.
+    rtcState.utc_us -= 900000;
+    CHECK(!time_source_poll());
+    CHECK(time_source_current() == &ntp);
+    CHECK(clock_error_us() == 0);
+    mock_time_advance_us(3600ull * 1000000);
+    CHECK(!time_source_poll());
+    CHECK(time_source_current() == &ntp);
+    CHECK(clock_error_us() == 0);
+    CHECK(rtcState.reads == 3);
+    printf("RTC declined, clock error bound after 1 h without NTP %u us\n", (unsigned)time_source_error_us());
+
+    // A worse NTP answer than the clock is not used either, a better one is
+    uint32_t bound = time_source_error_us();
+    CHECK(!time_source_offer(&ntp, true_us() + 100000, time_us_64(), bound + 1));
+    CHECK(clock_error_us() == 0);
+    CHECK(time_source_offer(&ntp, true_us(), time_us_64(), NTP_ERROR_US));
+    CHECK(time_source_error_us() == NTP_ERROR_US);
+
+    // A small offset is slewed out
+    mock_time_advance_us(64ull * 1000000);
+    CHECK(ntp_result(20000, NTP_ERROR_US));
+    clock_discipline_t before = *clock_discipline_state();
+    int32_t rate = timekeeping_get_rate();
+    CHECK(before.phase_us == 20000 && before.slew_ppb > 0);
+
+    // 300 ms off with a distance worse than the clock: no slew, no step, the loop keeps going
+    int64_t local = timekeeping_realtime_us();
+    CHECK(!ntp_result(300000, time_source_error_us() + 1));
+    const clock_discipline_t *after = clock_discipline_state();
+    CHECK(after->phase_us == before.phase_us);
+    CHECK(after->slew_ppb == before.slew_ppb);
+    CHECK(after->last_offset_us == before.last_offset_us);
+    CHECK(after->updates == before.updates);
+    CHECK(timekeeping_get_rate() == rate);
+    CHECK(timekeeping_realtime_us() == local);
+    printf("NTP sample 300 ms off and worse than the clock dropped, slewing %d ppb on\n", (int)after->slew_ppb);
+
+    // The same offset from a good sample steps the clock and ends the slew
+    CHECK(ntp_result(300000, NTP_ERROR_US));
+    CHECK(timekeeping_realtime_us() == local + 300000);
+    CHECK(clock_discipline_state()->phase_us == 0 && clock_discipline_state()->slew_ppb == 0);
+    CHECK(clock_discipline_state()->poll == CLOCK_DISCIPLINE_MIN_POLL);
+
+    return check_result();
+}
@@ -0,0 +1,165 @@
+/* warm_restart_test.c
+ *
+ * The clock over mocked watchdog resets: after a hang the gap between the last snapshot and the reset
+ * comes from the last feed of the watchdog, a requested reboot loses no time, and a reset whose time
+ * is not known leaves the clock unset. The time source is a stand-in that keeps the restored sample:
+ * the one of time_source.c would keep its state over the mocked resets, unlike on the board.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/time.h"
+#include "hardware/watchdog.h"
+#include "timekeeping.h"
+#include "time_source.h"
+#include "holdover.h"
+#include "warm_restart.h"
+#include "mock_hardware.h"
+#include "check.h"
+
+#define EPOCH_US (1767225600ll * 1000000)   // 2026-01-01
+#define NTP_ERROR_US 15000
+#define BOOT_US 250000                      // Reset to main(), counted by the timer
+#define FEED_US 100000                      // Main loop period
+
+//----------------------------------------------------------------------------------------
+// Stand-in for time_source.c
+
+static struct {
+    bool set;
+    int64_t utc_us;
+    uint64_t timer_us;
+    uint32_t error_us;
+} restored;
+
+uint32_t time_source_error_us(void)
+{
+    return NTP_ERROR_US;
+}
+
+bool time_source_offer(time_source_t *source, int64_t utcUs, uint64_t timerUs, uint32_t errorUs)
+{
+    (void)source;
+    restored.set = true;
+    restored.utc_us = utcUs;
+    restored.timer_us = timerUs;
+    restored.error_us = errorUs;
+    timekeeping_set(utcUs, timerUs);
+    return true;
+}
+
+//----------------------------------------------------------------------------------------
+
+// True time when the timer of the current run was 0
+static int64_t runStartUs = EPOCH_US;
+
+static int64_t true_us(void)
+{
+    return runStartUs + (int64_t)time_us_64();
+}
+
+static int64_t clock_error_us(void)
+{
+    return timekeeping_realtime_us() - true_us();
+}
+
+static void boot(void)
+{
+    restored.set = false;
+    mock_time_advance_us(BOOT_US);
+    timekeeping_init();
+    holdover_init();
+}
+
+// The main loop for seconds: feeds every FEED_US, saves on every whole second, ends right after a save
+static void run(uint32_t seconds)
+{
+    for (uint32_t i = 0; i < seconds * 1000000 / FEED_US; i++)
+    {
+        mock_time_advance_us(FEED_US);
+        warm_restart_feed();
+        if ((i + 1) % (1000000 / FEED_US) == 0)
+        {
+            warm_restart_save(false);
+        }
+    }
+}
+
+// The loop hangs afterUs after the last save, having fed the watchdog once more
+static void hang(uint64_t afterUs)
+{
+    mock_time_advance_us(afterUs);
+    warm_restart_feed();
+    runStartUs += (int64_t)mock_watchdog_fire();
+    boot();
+}
+
+int main(void)
+{
+    mock_hardware_reset();
+    boot();
+    CHECK(!warm_restart_restore());
+    printf("Power-on: no snapshot\n");
+
+    timekeeping_set(true_us(), time_us_64());
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+    run(20);
+
+    // Hangs early and late in the second give gaps of almost the timeout and of more than it,
+    // the old guess of half of the longest gap was up to 3 s off
+    const uint64_t hangs[] = { 0, FEED_US, 700000, WARM_RESTART_INTERVAL_US };
+    for (uint32_t i = 0; i < count_of(hangs); i++)
+    {
+        hang(hangs[i]);
+        CHECK(warm_restart_restore() && restored.set);
+        CHECK(llabs(clock_error_us()) <= 5000);
+        CHECK((uint64_t)llabs(clock_error_us()) + NTP_ERROR_US <= restored.error_us);
+        CHECK(restored.error_us < NTP_ERROR_US + 6000);
+        printf("Hang %4u ms after the snapshot: clock %lld us off, error bound %u us\n", (unsigned)(hangs[i] / 1000),
+               (long long)clock_error_us(), (unsigned)restored.error_us);
+
+        // Used once
+        restored.set = false;
+        CHECK(!warm_restart_restore() && !restored.set);
+
+        // NTP answers again before the next one
+        timekeeping_set(true_us(), time_us_64());
+        watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+        run(2);
+    }
+
+    // A reboot announced by a snapshot right before it
+    timekeeping_set(true_us(), time_us_64());
+    mock_time_advance_us(300000);
+    warm_restart_save(true);
+    runStartUs += (int64_t)time_us_64();
+    mock_watchdog_reboot();
+    boot();
+    CHECK(warm_restart_restore() && restored.set);
+    CHECK(llabs(clock_error_us()) <= 5000);
+    printf("Requested reboot: clock %lld us off\n", (long long)clock_error_us());
+
+    // A reboot without its snapshot, the last one is 300 ms old but nothing says so
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+    run(2);
+    mock_time_advance_us(300000);
+    mock_watchdog_reboot();
+    boot();
+    CHECK(!warm_restart_restore() && !restored.set);
+
+    // The loop fed the watchdog for seconds without saving: the feed does not time the snapshot
+    timekeeping_set(true_us(), time_us_64());
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+    run(2);
+    for (uint32_t i = 0; i < 30; i++)
+    {
+        mock_time_advance_us(FEED_US);
+        warm_restart_feed();
+    }
+    runStartUs += (int64_t)mock_watchdog_fire();
+    boot();
+    CHECK(!warm_restart_restore() && !restored.set);
+    printf("Untimed resets: snapshot not used\n");
+
+    return check_result();
+}
@@ -0,0 +1,155 @@
+// WS2812 driver on the mocked PIO: color orders, storage modes, the capture hook and the wire time model
+#include <stdio.h>
+
+#include <vector>
+
+#include "WS2812.hpp"
+#include "pixel_kernels.h"
+#include "StripEmulator.hpp"
+#include "hardware/dma.h"
+#include "mock_hardware.h"
+#include "check.h"
+
+static const uint LENGTH = 10;
+
+static uint32_t testColor(uint i, bool white) {
+    return WS2812::RGBW(10 * i + 1, 10 * i + 2, 10 * i + 3, white ? 10 * i + 4 : 0);
+}
+
+// Frames handed to the capture hook, decoded back to colors
+struct Captured {
+    std::vector<uint32_t> pixels;
+    uint frames = 0;
+};
+
+static void onCapture(WS2812 &strip, uint first, const uint8_t *wire, uint count, uint64_t frameUs, void *context) {
+    (void)frameUs;
+    Captured *c = (Captured *)context;
+    if (first == 0) {
+        c->frames++;
+    }
+    c->pixels.resize(strip.getLength());
+    for (uint i = 0; i < count; i++) {
+        c->pixels[first + i] = strip.decodeWire(&wire[i * strip.getBytesPerPixel()]);
+    }
+}
+
+static void testFormat(WS2812::DataFormat format, WS2812::Storage storage) {
+    bool white = format == WS2812::FORMAT_WRGB;
+    printf("Format %d, storage %d\n", format, storage);
+    mock_hardware_reset();
+    Captured captured;
+    WS2812::setCaptureHook(onCapture, &captured);
+
+    WS2812 strip(2, LENGTH, pio0, 0, format, storage);
+    StripEmulator emulator(strip);
+
+    std::vector<uint32_t> expected;
+    for (uint i = 0; i < LENGTH; i++) {
+        strip.setPixelColor(i, testColor(i, white));
+        expected.push_back(testColor(i, white));
+    }
+    strip.show();
+    strip.waitIdle();
+    CHECK(emulator.getPixels() == expected);
+    CHECK(captured.pixels == expected);
+
+    // Same picture again: nothing goes out
+    strip.fill(0);
+    for (uint i = 0; i < LENGTH; i++) {
+        strip.setPixelColor(i, testColor(i, white));
+    }
+    strip.show();
+    strip.waitIdle();
+    CHECK(strip.getShowCount() == 1);
+    CHECK(strip.getSkippedShowCount() == 1);
+    CHECK(emulator.getFrames().size() == 1);
+    CHECK(captured.frames == 1);
+
+    // The line carries exactly the strip, the next frame waits for the latch
+    strip.clear();
+    strip.show();
+    strip.waitIdle();
+    const std::vector<StripEmulator::Frame> &frames = emulator.getFrames();
+    CHECK(frames.size() == 2);
+    if (frames.size() == 2) {
+        uint64_t wireNs = (uint64_t)LENGTH * strip.getBytesPerPixel() * 8 * MOCK_PIO_BIT_NS;
+        CHECK(frames[0].endNs - frames[0].startNs == wireNs);
+        CHECK(frames[1].startNs >= frames[0].endNs + StripEmulator::LATCH_US * 1000);
+        CHECK(frames[1].startNs - frames[0].startNs >= (uint64_t)strip.getWireTimeUs() * 1000 - 1000);
+        CHECK(frames[1].pixels == std::vector<uint32_t>(LENGTH, 0));
+    }
+    CHECK(strip.getTotalWireTimeUs() == 2ull * strip.getWireTimeUs());
+
+    WS2812::setCaptureHook(nullptr, nullptr);
+}
+
+// A brightness table scales the frames on the wire, not the stored pixels: setting it again does
+// not scale twice and turning it off brings the full colors back
+static void testLut(WS2812::Storage storage) {
+    printf("Brightness table, storage %d\n", storage);
+    mock_hardware_reset();
+    WS2812 strip(2, LENGTH, pio0, 0, WS2812::FORMAT_GRB, storage);
+    StripEmulator emulator(strip);
+
+    uint8_t lut[256];
+    pixel_lut_build(lut, 128, 1.0f);
+    uint32_t color = WS2812::RGB(200, 100, 50);
+    std::vector<uint32_t> scaled(LENGTH, WS2812::RGB(lut[200], lut[100], lut[50]));
+    strip.fill(color);
+    strip.setLut(lut);
+    strip.show();
+    strip.waitIdle();
+    CHECK(emulator.getPixels() == scaled);
+
+    strip.setLut(lut);
+    strip.show();
+    strip.waitIdle();
+    CHECK(emulator.getPixels() == scaled);
+    CHECK(strip.getShowCount() == 2);
+
+    // Unchanged pixels under the same table are not pushed again
+    strip.show();
+    CHECK(strip.getShowCount() == 2);
+
+    strip.setLut(nullptr);
+    strip.show();
+    strip.waitIdle();
+    CHECK(emulator.getPixels() == std::vector<uint32_t>(LENGTH, color));
+
+    // Frames from flash go through the table as well
+    if (storage == WS2812::STORAGE_PACKED) {
+        static const uint8_t frame[LENGTH * 3] = { 100, 200, 50 };
+        strip.setLut(lut);
+        strip.showFrame(frame);
+        strip.waitIdle();
+        CHECK(emulator.getPixels()[0] == WS2812::RGB(lut[200], lut[100], lut[50]));
+        CHECK(emulator.getPixels()[1] == 0);
+    }
+}
+
+// A strip gives its DMA channel back, creating strips over and over does not run out of channels
+static void testDestroy() {
+    printf("Destroy\n");
+    mock_hardware_reset();
+    for (uint i = 0; i < 3 * NUM_DMA_CHANNELS; i++) {
+        WS2812 strip(2, LENGTH, pio0, 0, WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED);
+        strip.fill(WS2812::RGB(1, 2, 3));
+        strip.show();
+    }
+    int channel = dma_claim_unused_channel(false);
+    CHECK(channel == 0);
+    dma_channel_unclaim(channel);
+}
+
+int main() {
+    testFormat(WS2812::FORMAT_GRB, WS2812::STORAGE_WORD);
+    testFormat(WS2812::FORMAT_RGB, WS2812::STORAGE_WORD);
+    testFormat(WS2812::FORMAT_WRGB, WS2812::STORAGE_WORD);
+    testFormat(WS2812::FORMAT_GRB, WS2812::STORAGE_PACKED);
+    testFormat(WS2812::FORMAT_WRGB, WS2812::STORAGE_PACKED);
+    testLut(WS2812::STORAGE_WORD);
+    testLut(WS2812::STORAGE_PACKED);
+    testDestroy();
+    return check_result();
+}
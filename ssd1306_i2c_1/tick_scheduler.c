@@ -0,0 +1,126 @@
+/* tick_scheduler.c
+ *
+ * The alarm reschedules itself from its own boundary (negative callback return value), so the
+ * latency of one tick does not delay the next one.
+ */
+#include <stdlib.h>
+
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "timekeeping.h"
+#include "tick_scheduler.h"
+
+static bool running;
+static alarm_id_t alarm;
+static uint64_t target;             // Timer value of the armed boundary
+static int64_t targetSecond;
+
+static volatile bool pending;
+static tick_t pendingTick;
+
+static tick_stats_t stats;
+static uint64_t alarmSum;
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+// First second boundary after the given timer value
+static void next_boundary(uint64_t after)
+{
+    targetSecond = floor_div(timekeeping_realtime_at(after), 1000000) + 1;
+    target = timekeeping_timer_at(targetSecond * 1000000);
+}
+
+static int64_t boundary_alarm(alarm_id_t id, void *user_data)
+{
+    (void)id;
+    (void)user_data;
+
+    int32_t late = (int32_t)(time_us_64() - target);
+    stats.ticks++;
+    stats.alarm_last = late;
+    if (late > stats.alarm_max)
+    {
+        stats.alarm_max = late;
+    }
+    alarmSum += (uint32_t)abs(late);
+    stats.alarm_mean = (uint32_t)(alarmSum / stats.ticks);
+
+    if (pending)
+    {
+        stats.missed++;
+    }
+    pendingTick.second = targetSecond;
+    pendingTick.timer_us = target;
+    pendingTick.minute = floor_div(targetSecond, 60) * 60 == targetSecond;
+    pending = true;
+    __sev();
+
+    uint64_t previous = target;
+    next_boundary(target);
+    return -(int64_t)(target - previous);
+}
+
+static void arm(void)
+{
+    next_boundary(time_us_64());
+    alarm = add_alarm_at(from_us_since_boot(target), boundary_alarm, NULL, true);
+}
+
+void tick_scheduler_start(void)
+{
+    if (!running)
+    {
+        running = true;
+        arm();
+    }
+}
+
+void tick_scheduler_rephase(void)
+{
+    if (!running)
+    {
+        return;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+    cancel_alarm(alarm);
+    stats.rephases++;
+    arm();
+    restore_interrupts(irq);
+}
+
+bool tick_scheduler_poll(tick_t *tick)
+{
+    if (!pending)
+    {
+        return false;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+    *tick = pendingTick;
+    pending = false;
+    restore_interrupts(irq);
+
+    int32_t late = (int32_t)(time_us_64() - tick->timer_us);
+    stats.dispatch_last = late;
+    if (late > stats.dispatch_max)
+    {
+        stats.dispatch_max = late;
+    }
+    return true;
+}
+
+uint64_t tick_scheduler_next_us(void)
+{
+    return target;
+}
+
+void tick_scheduler_stats(tick_stats_t *out)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    *out = stats;
+    restore_interrupts(irq);
+}
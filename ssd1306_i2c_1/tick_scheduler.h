@@ -0,0 +1,52 @@
+/* tick_scheduler.h
+ *
+ * Ticks on the second boundaries of the wall clock (timekeeping.h).
+ *
+ * A timer alarm is armed for the timer value at which the clock reaches the next full second,
+ * so ticks stay in phase with UTC instead of drifting like a sleep loop. After the clock is set
+ * the alarm is moved to the new boundary (tick_scheduler_rephase()).
+ * The alarm handler only queues the tick, the work is done by the main loop in tick_scheduler_poll().
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int64_t second;         // Unix second that starts at the tick
+    uint64_t timer_us;      // time_us_64() of the boundary
+    bool minute;            // The second is the first one of a minute
+} tick_t;
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t missed;        // Ticks replaced by the next one before they were polled
+    uint32_t rephases;
+    int32_t alarm_last;     // µs between the boundary and the alarm handler
+    int32_t alarm_max;
+    uint32_t alarm_mean;
+    int32_t dispatch_last;  // µs between the boundary and the main loop getting the tick
+    int32_t dispatch_max;
+} tick_stats_t;
+
+// Arms the alarm for the next second boundary
+void tick_scheduler_start(void);
+
+// Moves the alarm after the clock was set, suitable as timekeeping callback
+void tick_scheduler_rephase(void);
+
+// Returns true and the tick when a boundary has passed since the last call
+bool tick_scheduler_poll(tick_t *tick);
+
+// Timer value of the next boundary, to sleep until it
+uint64_t tick_scheduler_next_us(void);
+
+void tick_scheduler_stats(tick_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
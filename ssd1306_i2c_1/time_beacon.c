@@ -0,0 +1,261 @@
+/* time_beacon.c
+ *
+ * The receive callback only stamps the beacon and keeps the best offset of the window, the clock
+ * is adjusted in time_beacon_service(). Offsets keep the corrections applied until they were
+ * measured (clock_discipline_correction_us()), as the NTP samples do.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/cyw43_arch.h"
+#include "hardware/sync.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+
+#include "timekeeping.h"
+#include "holdover.h"
+#include "clock_discipline.h"
+#include "ntp_client.h"
+#include "time_beacon.h"
+
+#define TIME_BEACON_MAGIC 0x54424331u       // "TBC1"
+#define TIME_BEACON_FIRST 8                 // Beacons before the first offset is taken
+#define TIME_BEACON_ERROR_US 2000           // Wi-Fi latency of the least delayed beacon
+
+//----------------------------------------------------------------------------------------
+// Format, big endian
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// FNV-1a
+static uint32_t checksum(const uint8_t *buf, uint32_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ buf[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void time_beacon_encode(const time_beacon_t *beacon, uint8_t *buf)
+{
+    put32(buf, TIME_BEACON_MAGIC);
+    buf[4] = beacon->stratum;
+    buf[5] = 0;
+    buf[6] = beacon->sequence >> 8;
+    buf[7] = beacon->sequence;
+    put32(buf + 8, (uint32_t)((uint64_t)beacon->utc_us >> 32));
+    put32(buf + 12, (uint32_t)beacon->utc_us);
+    put32(buf + 16, beacon->error_us);
+    put32(buf + 20, checksum(buf, 20));
+}
+
+bool time_beacon_decode(time_beacon_t *beacon, const uint8_t *buf, uint32_t len)
+{
+    if (len < TIME_BEACON_LEN || get32(buf) != TIME_BEACON_MAGIC || get32(buf + 20) != checksum(buf, 20))
+        return false;
+
+    beacon->stratum = buf[4];
+    beacon->sequence = (uint16_t)(buf[6] << 8 | buf[7]);
+    beacon->utc_us = (int64_t)((uint64_t)get32(buf + 8) << 32 | get32(buf + 12));
+    beacon->error_us = get32(buf + 16);
+    return true;
+}
+
+//----------------------------------------------------------------------------------------
+// Service
+
+static uint8_t role;
+static struct udp_pcb *pcb;
+static struct pbuf *buffer;         // Master: allocated once, reused for every beacon
+static ip_addr_t group;
+static time_beacon_stats_t stats;
+static time_source_t source = { "beacon", NULL, NULL, NULL };
+
+// Window of received beacons, written by the receive callback
+static uint32_t windowCount;
+static uint64_t windowStart;
+static int64_t bestOffset;          // Largest offset plus the corrections until then
+static uint32_t bestError;
+static uint64_t lastReceived;
+static uint16_t lastSequence;
+
+static void beacon_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    (void)arg;
+    (void)upcb;
+    (void)addr;
+    (void)port;
+    uint64_t received = time_us_64();
+
+    uint8_t buf[TIME_BEACON_LEN];
+    uint32_t len = pbuf_copy_partial(p, buf, sizeof(buf), 0);
+    pbuf_free(p);
+
+    time_beacon_t beacon;
+    if (!time_beacon_decode(&beacon, buf, len) || beacon.error_us > TIME_BEACON_MAX_ERROR_US)
+    {
+        stats.invalid++;
+        return;
+    }
+
+    int64_t offset = beacon.utc_us - timekeeping_realtime_at(received) + clock_discipline_correction_us(received);
+    if (stats.received && (uint16_t)(beacon.sequence - lastSequence) > 1)
+    {
+        stats.lost += (uint16_t)(beacon.sequence - lastSequence) - 1;
+    }
+    stats.received++;
+    lastSequence = beacon.sequence;
+    lastReceived = received;
+
+    if (!windowCount || offset > bestOffset)
+    {
+        bestOffset = offset;
+        bestError = beacon.error_us;
+    }
+    if (!windowCount++)
+    {
+        windowStart = received;
+    }
+}
+
+bool time_beacon_init(uint8_t r)
+{
+    role = r;
+    if (role == TIME_BEACON_OFF)
+        return true;
+
+    ipaddr_aton(TIME_BEACON_GROUP, &group);
+    pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb)
+        return false;
+
+    if (role == TIME_BEACON_MASTER)
+    {
+        buffer = pbuf_alloc(PBUF_TRANSPORT, TIME_BEACON_LEN, PBUF_RAM);
+        return buffer != NULL;
+    }
+
+    if (udp_bind(pcb, IP_ANY_TYPE, TIME_BEACON_PORT) != ERR_OK ||
+        igmp_joingroup(IP4_ADDR_ANY4, ip_2_ip4(&group)) != ERR_OK)
+    {
+        printf("time beacon: can not join %s\n", TIME_BEACON_GROUP);
+        return false;
+    }
+    udp_recv(pcb, beacon_recv, NULL);
+    return true;
+}
+
+void time_beacon_on_second(void)
+{
+    if (role != TIME_BEACON_MASTER || !buffer)
+        return;
+
+    // Only a clock that NTP keeps right is passed on
+    uint32_t error = time_source_error_us();
+    if (time_source_current() != ntp_client_time_source() || error > TIME_BEACON_MAX_ERROR_US)
+        return;
+
+    ntp_client_status_t sync;
+    ntp_client_status(&sync);
+
+    time_beacon_t beacon;
+    beacon.stratum = sync.stratum + 1;
+    beacon.sequence = (uint16_t)stats.sent;
+    beacon.error_us = error;
+
+    cyw43_arch_lwip_begin();
+    if (buffer->ref > 1)
+    {
+        // The previous beacon still waits in the driver
+        cyw43_arch_lwip_end();
+        return;
+    }
+    pbuf_remove_header(buffer, buffer->tot_len - TIME_BEACON_LEN);
+    beacon.utc_us = timekeeping_realtime_us();
+    time_beacon_encode(&beacon, (uint8_t *)buffer->payload);
+    if (udp_sendto(pcb, buffer, &group, TIME_BEACON_PORT) == ERR_OK)
+    {
+        stats.sent++;
+    }
+    cyw43_arch_lwip_end();
+}
+
+void time_beacon_service(void)
+{
+    if (role != TIME_BEACON_FOLLOWER || !pcb)
+        return;
+
+    bool locked = time_source_current() == &source;
+    uint32_t irq = save_and_disable_interrupts();
+    uint64_t now = time_us_64();
+    bool fresh = stats.received && now - lastReceived < TIME_BEACON_TIMEOUT_MS * 1000ull;
+
+    // A poll interval of the discipline once the clock follows the beacons, a few beacons before
+    bool due = fresh && windowCount &&
+               (locked ? now - windowStart >= clock_discipline_poll_s() * 1000000ull : windowCount >= TIME_BEACON_FIRST);
+    int64_t offset = bestOffset;
+    uint32_t error = bestError;
+    if (due || !fresh)
+    {
+        windowCount = 0;
+    }
+    restore_interrupts(irq);
+
+    // One upstream query per site: NTP rests while the master speaks
+    if (fresh != stats.following)
+    {
+        stats.following = fresh;
+        ntp_client_suspend(fresh);
+        printf(fresh ? "time beacons received, NTP suspended\n" : "time beacons lost, back to NTP\n");
+    }
+    if (!due)
+        return;
+
+    offset -= clock_discipline_correction_us(now);
+    error += TIME_BEACON_ERROR_US;
+    int64_t utcUs = timekeeping_realtime_at(now) + offset;
+
+    bool used = false;
+    if (locked && clock_discipline_offset(offset, now))
+    {
+        used = time_source_confirm(&source, now, error);
+    }
+    else if (time_source_offer(&source, utcUs, now, error))
+    {
+        clock_discipline_step(offset);
+        used = true;
+    }
+
+    if (used)
+    {
+        holdover_sync(utcUs, now);
+        stats.updates++;
+        stats.last_offset_us = offset;
+    }
+}
+
+time_source_t *time_beacon_time_source(void)
+{
+    return &source;
+}
+
+void time_beacon_stats(time_beacon_stats_t *s)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    *s = stats;
+    restore_interrupts(irq);
+}
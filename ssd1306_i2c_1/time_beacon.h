@@ -0,0 +1,78 @@
+/* time_beacon.h
+ *
+ * Keeps a group of clocks in one room ticking together: one master polls NTP and multicasts a
+ * short beacon every second, the followers slew their clocks to it and stop polling NTP.
+ *
+ * A beacon carries the master's UTC in µs, taken right before it is sent, and the master's error
+ * bound. Beacons are only ever late, so a follower takes the one with the largest offset within
+ * a poll interval of the clock discipline (the least delayed one) and hands that offset to the
+ * loop like an NTP result. This also covers access points that hold multicast frames until the
+ * next DTIM beacon while a station sleeps. When no beacon came for TIME_BEACON_TIMEOUT_MS the
+ * follower polls NTP itself again, until the beacons are back.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "time_source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIME_BEACON_GROUP "239.255.0.123"   // Organisation-local multicast
+#define TIME_BEACON_PORT 12300
+#define TIME_BEACON_LEN 24
+#define TIME_BEACON_TIMEOUT_MS 10000        // Followers fall back to NTP after that
+#define TIME_BEACON_MAX_ERROR_US 50000      // The master stays silent with a worse clock
+
+enum {
+    TIME_BEACON_OFF = 0,
+    TIME_BEACON_MASTER = 1,
+    TIME_BEACON_FOLLOWER = 2
+};
+
+typedef struct {
+    uint8_t stratum;        // Of the master, NTP stratum + 1
+    uint16_t sequence;
+    int64_t utc_us;         // Master's clock when the beacon was sent
+    uint32_t error_us;      // Master's error bound
+} time_beacon_t;
+
+void time_beacon_encode(const time_beacon_t *beacon, uint8_t *buf);
+
+// False for anything that is not a valid beacon
+bool time_beacon_decode(time_beacon_t *beacon, const uint8_t *buf, uint32_t len);
+
+typedef struct {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t invalid;
+    uint32_t lost;          // Gaps in the sequence numbers
+    uint32_t updates;       // Offsets handed to the clock
+    int64_t last_offset_us;
+    bool following;         // Beacons arrive, NTP is suspended
+} time_beacon_stats_t;
+
+//----------------------------------------------------------------------------------------
+// Service
+
+// Opens the socket for the role (TIME_BEACON_*), followers join the group.
+// Call in lwIP context after cyw43_arch_init().
+bool time_beacon_init(uint8_t role);
+
+// Master: sends a beacon. Call on every second boundary from the main loop.
+void time_beacon_on_second(void);
+
+// Follower: feeds the clock and switches between beacons and NTP. Call from the main loop.
+void time_beacon_service(void);
+
+// Register it with time_source_register() on followers
+time_source_t *time_beacon_time_source(void);
+
+void time_beacon_stats(time_beacon_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,122 @@
+/* time_source.c
+ */
+#include <stdio.h>
+
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "timekeeping.h"
+#include "time_source.h"
+
+static time_source_t *sources[TIME_SOURCE_MAX];
+static uint32_t count;
+
+static const time_source_t *current;
+static uint32_t errorAtSet;
+static uint64_t setAt;
+static volatile bool writeBack;
+
+bool time_source_register(time_source_t *source)
+{
+    if (count >= TIME_SOURCE_MAX)
+        return false;
+    sources[count++] = source;
+    return true;
+}
+
+uint32_t time_source_error_us(void)
+{
+    if (!current)
+        return UINT32_MAX;
+
+    uint64_t drift = (time_us_64() - setAt) * TIME_SOURCE_DRIFT_PPM / 1000000;
+    uint64_t error = errorAtSet + drift;
+    return error > UINT32_MAX ? UINT32_MAX : (uint32_t)error;
+}
+
+const time_source_t *time_source_current(void)
+{
+    return current;
+}
+
+bool time_source_offer(time_source_t *source, int64_t utcUs, uint64_t timerUs, uint32_t errorUs)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    bool better = errorUs <= time_source_error_us();
+    if (better)
+    {
+        current = source;
+        errorAtSet = errorUs;
+        setAt = timerUs;
+        writeBack = true;
+    }
+    restore_interrupts(irq);
+
+    // Sets the clock outside of the critical section, the timekeeping callback may do more work
+    if (better)
+    {
+        timekeeping_set(utcUs, timerUs);
+    }
+    return better;
+}
+
+bool time_source_confirm(time_source_t *source, uint64_t timerUs, uint32_t errorUs)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    bool better = errorUs <= time_source_error_us();
+    if (better)
+    {
+        current = source;
+        errorAtSet = errorUs;
+        setAt = timerUs;
+        writeBack = true;
+    }
+    restore_interrupts(irq);
+    return better;
+}
+
+bool time_source_poll(void)
+{
+    time_source_t *best = NULL;
+    int64_t bestUtc = 0;
+    uint64_t bestTimer = 0;
+    uint32_t bestError = UINT32_MAX;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int64_t utc;
+        uint64_t timer;
+        uint32_t error;
+        if (sources[i]->read && sources[i]->read(sources[i], &utc, &timer, &error) && error < bestError)
+        {
+            best = sources[i];
+            bestUtc = utc;
+            bestTimer = timer;
+            bestError = error;
+        }
+    }
+
+    if (best && time_source_offer(best, bestUtc, bestTimer, bestError))
+    {
+        printf("time from %s, error %u ms\n", best->name, (unsigned)(bestError / 1000));
+        return true;
+    }
+    return false;
+}
+
+void time_source_on_second(int64_t utcSeconds)
+{
+    if (!writeBack)
+        return;
+    writeBack = false;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (sources[i] != current && sources[i]->write)
+        {
+            if (!sources[i]->write(sources[i], utcSeconds))
+            {
+                printf("%s: write failed\n", sources[i]->name);
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+/* time_source.h
+ *
+ * Time sources of the clock (NTP, battery backed RTC, ...) and the choice between them.
+ *
+ * Every sample comes with an error bound. The clock's own error is the bound of the sample it was
+ * last set from, growing with the crystal drift since then. A sample is used only when it is at least
+ * as good as the clock at that moment, so a rough RTC sets the clock at boot, NTP takes over as soon
+ * as it answers and the RTC is never allowed to pull an NTP disciplined clock back.
+ * After the clock was set, writable sources (the RTC) are set from it on the next second boundary.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIME_SOURCE_MAX 4
+#define TIME_SOURCE_DRIFT_PPM 20    // Error growth of the free running clock
+
+typedef struct time_source {
+    const char *name;
+
+    // Reads the source: utcUs was the time when the timer read timerUs, errorUs bounds the error.
+    // NULL for sources that push their samples with time_source_offer().
+    bool (*read)(struct time_source *source, int64_t *utcUs, uint64_t *timerUs, uint32_t *errorUs);
+
+    // Sets the source, called on a second boundary with the whole second that starts. NULL if read-only.
+    bool (*write)(struct time_source *source, int64_t utcSeconds);
+
+    void *context;
+} time_source_t;
+
+bool time_source_register(time_source_t *source);
+
+// Reads all sources that can be read and sets the clock from the best one, if it beats the clock.
+// Returns true when the clock was set.
+bool time_source_poll(void);
+
+// A sample pushed by a source, returns true when it was used to set the clock
+bool time_source_offer(time_source_t *source, int64_t utcUs, uint64_t timerUs, uint32_t errorUs);
+
+// The source agrees with the clock within errorUs at timerUs, the clock is slewed instead of set
+// (clock_discipline.c). Same selection as time_source_offer().
+bool time_source_confirm(time_source_t *source, uint64_t timerUs, uint32_t errorUs);
+
+// Current error bound of the clock in µs, UINT32_MAX before it was set
+uint32_t time_source_error_us(void);
+
+// Source the clock was last set from, NULL before
+const time_source_t *time_source_current(void);
+
+// Call on every second boundary (see tick_scheduler.h), writes the clock back to the other sources
+void time_source_on_second(int64_t utcSeconds);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,273 @@
+/* time_zone.c
+ *
+ * POSIX TZ format: std offset [dst [offset] [,start[/time],end[/time]]]
+ * Names are 3+ letters or <quoted>, offsets are hh[:mm[:ss]] west of UTC (hence "CET-1" is UTC+1).
+ * The DST offset defaults to one hour more than standard time and the rules to the US ones.
+ */
+#include <string.h>
+#include <ctype.h>
+
+#include "time_zone.h"
+#include "civil_time.h"
+
+#define DEFAULT_TRANSITION_TIME (2 * 3600)
+
+//----------------------------------------------------------------------------------------
+// Parser
+
+static bool parse_name(const char **p, char *name)
+{
+    const char *s = *p;
+    size_t len = 0;
+
+    if (*s == '<')
+    {
+        s++;
+        while (s[len] && s[len] != '>')
+            len++;
+        if (s[len] != '>')
+            return false;
+        *p = s + len + 1;
+    }
+    else
+    {
+        while (isalpha((unsigned char)s[len]))
+            len++;
+        *p = s + len;
+    }
+
+    if (len < 3 || len >= TIME_ZONE_NAME_LEN)
+        return false;
+    memcpy(name, s, len);
+    name[len] = 0;
+    return true;
+}
+
+static bool parse_number(const char **p, int *value, int max)
+{
+    if (!isdigit((unsigned char)**p))
+        return false;
+    int v = 0;
+    while (isdigit((unsigned char)**p))
+    {
+        v = v * 10 + (*(*p)++ - '0');
+        if (v > max)
+            return false;
+    }
+    *value = v;
+    return true;
+}
+
+// [+|-]hh[:mm[:ss]], returns seconds
+static bool parse_time(const char **p, int32_t *seconds, int maxHours)
+{
+    int sign = 1;
+    if (**p == '+' || **p == '-')
+    {
+        sign = (**p == '-') ? -1 : 1;
+        (*p)++;
+    }
+
+    int h, m = 0, s = 0;
+    if (!parse_number(p, &h, maxHours))
+        return false;
+    if (**p == ':')
+    {
+        (*p)++;
+        if (!parse_number(p, &m, 59))
+            return false;
+        if (**p == ':')
+        {
+            (*p)++;
+            if (!parse_number(p, &s, 59))
+                return false;
+        }
+    }
+    *seconds = sign * (h * 3600 + m * 60 + s);
+    return true;
+}
+
+// Mm.w.d, Jn or n, optionally followed by /time
+static bool parse_transition(const char **p, time_zone_transition_t *tr)
+{
+    int v;
+
+    memset(tr, 0, sizeof(*tr));
+    if (**p == 'M')
+    {
+        int week, weekday;
+        (*p)++;
+        if (!parse_number(p, &v, 12) || v < 1 || *(*p)++ != '.')
+            return false;
+        if (!parse_number(p, &week, 5) || week < 1 || *(*p)++ != '.')
+            return false;
+        if (!parse_number(p, &weekday, 6))
+            return false;
+        tr->type = TIME_ZONE_RULE_MONTH;
+        tr->month = v;
+        tr->week = week;
+        tr->weekday = weekday;
+    }
+    else if (**p == 'J')
+    {
+        (*p)++;
+        if (!parse_number(p, &v, 365) || v < 1)
+            return false;
+        tr->type = TIME_ZONE_RULE_JULIAN;
+        tr->day = v;
+    }
+    else
+    {
+        if (!parse_number(p, &v, 365))
+            return false;
+        tr->type = TIME_ZONE_RULE_DAY;
+        tr->day = v;
+    }
+
+    tr->time = DEFAULT_TRANSITION_TIME;
+    if (**p == '/')
+    {
+        (*p)++;
+        // RFC 8536 allows -167..167 hours
+        if (!parse_time(p, &tr->time, 167))
+            return false;
+    }
+    return true;
+}
+
+static void set_utc(time_zone_t *tz)
+{
+    memset(tz, 0, sizeof(*tz));
+    strcpy(tz->std_name, "UTC");
+    strcpy(tz->dst_name, "UTC");
+}
+
+bool time_zone_parse(time_zone_t *tz, const char *rule)
+{
+    const char *p = rule;
+    int32_t offset;
+
+    set_utc(tz);
+
+    if (!parse_name(&p, tz->std_name) || !parse_time(&p, &offset, 24))
+    {
+        set_utc(tz);
+        return false;
+    }
+    tz->std_offset = -offset;
+    tz->dst_offset = tz->std_offset;
+
+    if (*p == 0)
+    {
+        strcpy(tz->dst_name, tz->std_name);
+        return true;
+    }
+
+    if (!parse_name(&p, tz->dst_name))
+    {
+        set_utc(tz);
+        return false;
+    }
+    tz->has_dst = true;
+    tz->dst_offset = tz->std_offset + 3600;
+
+    if (*p && *p != ',')
+    {
+        if (!parse_time(&p, &offset, 24))
+        {
+            set_utc(tz);
+            return false;
+        }
+        tz->dst_offset = -offset;
+    }
+
+    if (*p == 0)
+    {
+        // No rules given: second Sunday in March to first Sunday in November
+        p = ",M3.2.0,M11.1.0";
+    }
+
+    if (*p++ != ',' || !parse_transition(&p, &tz->start) ||
+        *p++ != ',' || !parse_transition(&p, &tz->end) || *p != 0)
+    {
+        set_utc(tz);
+        return false;
+    }
+
+    // Nothing cached yet
+    tz->year_start = 0;
+    tz->year_end = 0;
+    return true;
+}
+
+//----------------------------------------------------------------------------------------
+// Transitions
+
+// Day since 1970-01-01 on which the transition happens in the given year
+static int64_t transition_day(const time_zone_transition_t *tr, int64_t year)
+{
+    int64_t jan1 = civil_days_from_date(year, 1, 1);
+
+    switch (tr->type)
+    {
+    case TIME_ZONE_RULE_JULIAN:
+        // Feb 29 is never counted
+        return jan1 + tr->day - 1 + (civil_is_leap(year) && tr->day >= 60);
+
+    case TIME_ZONE_RULE_DAY:
+        return jan1 + tr->day;
+
+    default:
+    {
+        int64_t first = civil_days_from_date(year, tr->month, 1);
+        unsigned day = (tr->weekday + 7 - civil_weekday(first)) % 7 + (tr->week - 1) * 7;
+        while (day >= civil_days_in_month(year, tr->month))
+            day -= 7;
+        return first + day;
+    }
+    }
+}
+
+static void prepare_year(time_zone_t *tz, int64_t year)
+{
+    tz->year_start = civil_days_from_date(year, 1, 1) * CIVIL_SECONDS_PER_DAY;
+    tz->year_end = civil_days_from_date(year + 1, 1, 1) * CIVIL_SECONDS_PER_DAY;
+
+    // Transition times are local, in the time that is in effect before the switch
+    tz->dst_start = transition_day(&tz->start, year) * CIVIL_SECONDS_PER_DAY + tz->start.time - tz->std_offset;
+    tz->dst_end = transition_day(&tz->end, year) * CIVIL_SECONDS_PER_DAY + tz->end.time - tz->dst_offset;
+}
+
+int32_t time_zone_offset(time_zone_t *tz, int64_t utc, bool *isDst)
+{
+    bool dst = false;
+
+    if (tz->has_dst)
+    {
+        if (utc < tz->year_start || utc >= tz->year_end)
+        {
+            civil_time_t t;
+            civil_from_unix(utc, &t);
+            prepare_year(tz, t.year);
+        }
+
+        if (tz->dst_start < tz->dst_end)
+        {
+            dst = utc >= tz->dst_start && utc < tz->dst_end;
+        }
+        else
+        {
+            // Southern hemisphere, DST spans the new year
+            dst = utc >= tz->dst_start || utc < tz->dst_end;
+        }
+    }
+
+    if (isDst)
+        *isDst = dst;
+    return dst ? tz->dst_offset : tz->std_offset;
+}
+
+const char *time_zone_name(const time_zone_t *tz, bool isDst)
+{
+    return isDst ? tz->dst_name : tz->std_name;
+}
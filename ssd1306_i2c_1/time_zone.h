@@ -0,0 +1,60 @@
+/* time_zone.h
+ *
+ * Local time from a POSIX TZ rule, for example "CET-1CEST,M3.5.0,M10.5.0/3".
+ *
+ * The DST transitions of one year are computed in advance, converting UTC to local time
+ * is then a comparison with two instants. The next year is computed when the clock gets there.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIME_ZONE_NAME_LEN 8
+
+typedef struct {
+    uint8_t type;       // TIME_ZONE_RULE_*
+    uint8_t month;      // Mm.w.d: 1..12
+    uint8_t week;       // Mm.w.d: 1..5, 5 is the last one in the month
+    uint8_t weekday;    // Mm.w.d: 0 = Sunday
+    uint16_t day;       // Jn: 1..365 without Feb 29, n: 0..365
+    int32_t time;       // Seconds after local midnight, may be negative or over 24 h
+} time_zone_transition_t;
+
+typedef struct {
+    char std_name[TIME_ZONE_NAME_LEN];
+    char dst_name[TIME_ZONE_NAME_LEN];
+    int32_t std_offset;     // Seconds east of UTC, i.e. -3600 in the rule is +3600 here
+    int32_t dst_offset;
+    bool has_dst;
+    time_zone_transition_t start, end;
+
+    // Transitions of the year in [year_start, year_end), UTC seconds
+    int64_t year_start;
+    int64_t year_end;
+    int64_t dst_start;
+    int64_t dst_end;
+} time_zone_t;
+
+enum {
+    TIME_ZONE_RULE_MONTH = 0,   // Mm.w.d
+    TIME_ZONE_RULE_JULIAN = 1,  // Jn
+    TIME_ZONE_RULE_DAY = 2      // n
+};
+
+// Parse a POSIX TZ rule. Returns false and leaves tz as UTC when the rule is not valid.
+bool time_zone_parse(time_zone_t *tz, const char *rule);
+
+// Offset of local time from UTC in seconds at the given UTC instant, isDst may be NULL
+int32_t time_zone_offset(time_zone_t *tz, int64_t utc, bool *isDst);
+
+// Zone abbreviation, e.g. "CET" or "CEST"
+const char *time_zone_name(const time_zone_t *tz, bool isDst);
+
+#ifdef __cplusplus
+}
+#endif
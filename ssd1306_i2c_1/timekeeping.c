@@ -0,0 +1,198 @@
+/* timekeeping.c
+ *
+ * Writers bump the sequence to odd, update the anchor and bump it to even again. They hold a
+ * hardware spin lock, which also masks interrupts, so a reader on the same core can never
+ * interrupt an update half way and spin forever.
+ */
+#include <errno.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "timekeeping.h"
+
+typedef struct {
+    int64_t utc_us;         // Realtime at the anchor
+    uint64_t timer_us;      // time_us_64() at the anchor
+    int32_t rate_ppb;       // Timer rate correction since the anchor
+} anchor_t;
+
+static volatile uint32_t sequence;
+static anchor_t anchor;
+static bool set;
+static spin_lock_t *writeLock;
+static timekeeping_callback_t setCallback;
+
+void timekeeping_init(void)
+{
+    if (!writeLock)
+    {
+        writeLock = spin_lock_instance(spin_lock_claim_unused(true));
+    }
+}
+
+void timekeeping_set(int64_t utcUs, uint64_t timerUs)
+{
+    uint32_t irq = spin_lock_blocking(writeLock);
+    sequence++;
+    __dmb();
+    anchor.utc_us = utcUs;
+    anchor.timer_us = timerUs;
+    set = true;
+    __dmb();
+    sequence++;
+    spin_unlock(writeLock, irq);
+
+    if (setCallback)
+    {
+        setCallback();
+    }
+}
+
+static int64_t realtime_at(const anchor_t *a, uint64_t timerUs)
+{
+    int64_t elapsed = (int64_t)(timerUs - a->timer_us);
+    return a->utc_us + elapsed + elapsed * a->rate_ppb / 1000000000;
+}
+
+void timekeeping_set_rate(int32_t ppb)
+{
+    uint32_t irq = spin_lock_blocking(writeLock);
+    // Re-anchor at the current time, so only the future is affected and the clock does not jump
+    uint64_t now = time_us_64();
+    int64_t utc = realtime_at(&anchor, now);
+    sequence++;
+    __dmb();
+    anchor.utc_us = utc;
+    anchor.timer_us = now;
+    anchor.rate_ppb = ppb;
+    __dmb();
+    sequence++;
+    spin_unlock(writeLock, irq);
+}
+
+int32_t timekeeping_get_rate(void)
+{
+    return anchor.rate_ppb;
+}
+
+void timekeeping_set_callback(timekeeping_callback_t callback)
+{
+    setCallback = callback;
+}
+
+static void read_anchor(anchor_t *a)
+{
+    uint32_t seq;
+    do
+    {
+        seq = sequence;
+        __dmb();
+        *a = anchor;
+        __dmb();
+    } while ((seq & 1) || seq != sequence);
+}
+
+bool timekeeping_is_set(void)
+{
+    return set;
+}
+
+uint64_t timekeeping_monotonic_us(void)
+{
+    return time_us_64();
+}
+
+int64_t timekeeping_realtime_at(uint64_t timerUs)
+{
+    anchor_t a;
+    read_anchor(&a);
+    return realtime_at(&a, timerUs);
+}
+
+uint64_t timekeeping_timer_at(int64_t utcUs)
+{
+    anchor_t a;
+    read_anchor(&a);
+    // Inverse of realtime_at(): elapsed / (1 + rate)
+    int64_t elapsed = utcUs - a.utc_us;
+    return a.timer_us + (uint64_t)(elapsed - elapsed * a.rate_ppb / (1000000000 + a.rate_ppb));
+}
+
+int64_t timekeeping_realtime_us(void)
+{
+    return timekeeping_realtime_at(time_us_64());
+}
+
+//----------------------------------------------------------------------------------------
+// newlib hooks, these replace the weak versions of the SDK runtime.
+// Host builds (PICO_NO_HARDWARE) keep the ones of their C library.
+
+#if !PICO_NO_HARDWARE
+
+#ifndef CLOCK_REALTIME
+#define CLOCK_REALTIME ((clockid_t)1)
+#endif
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC ((clockid_t)4)
+#endif
+
+int _gettimeofday(struct timeval *tv, void *tz);
+int settimeofday(const struct timeval *tv, const struct timezone *tz);
+int clock_gettime(clockid_t clock_id, struct timespec *tp);
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+// Used by time() and gettimeofday()
+int _gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+    if (tv)
+    {
+        int64_t us = timekeeping_realtime_us();
+        int64_t s = floor_div(us, 1000000);
+        tv->tv_sec = (time_t)s;
+        tv->tv_usec = (suseconds_t)(us - s * 1000000);
+    }
+    return 0;
+}
+
+int settimeofday(const struct timeval *tv, const struct timezone *tz)
+{
+    (void)tz;
+    if (tv)
+    {
+        timekeeping_set((int64_t)tv->tv_sec * 1000000 + tv->tv_usec, time_us_64());
+    }
+    return 0;
+}
+
+int clock_gettime(clockid_t clock_id, struct timespec *tp)
+{
+    int64_t us;
+
+    if (clock_id == CLOCK_REALTIME)
+    {
+        us = timekeeping_realtime_us();
+    }
+    else if (clock_id == CLOCK_MONOTONIC)
+    {
+        us = (int64_t)timekeeping_monotonic_us();
+    }
+    else
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int64_t s = floor_div(us, 1000000);
+    tp->tv_sec = (time_t)s;
+    tp->tv_nsec = (long)(us - s * 1000000) * 1000;
+    return 0;
+}
+
+#endif
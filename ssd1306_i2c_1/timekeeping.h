@@ -0,0 +1,50 @@
+/* timekeeping.h
+ *
+ * Wall clock of the project: a realtime anchor (UTC from NTP) paired with the 64-bit microsecond
+ * timer at the same instant. Time in between is extrapolated from the timer, so it has µs resolution
+ * and never depends on how often somebody updates it.
+ *
+ * Readers never block: the anchor is published with a sequence lock, a reader retries in the rare
+ * case it raced with an update. Any core and interrupt handlers may read.
+ * newlib's time(), gettimeofday() and clock_gettime() are routed here as well.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Claims the spin lock serializing writers, call once before the other functions
+void timekeeping_init(void);
+
+// Set the clock: utcUs (µs since 1970) was the time when the timer read timerUs
+void timekeeping_set(int64_t utcUs, uint64_t timerUs);
+
+// Correct the timer rate by ppb parts per billion, positive makes the clock run faster.
+// The correction applies from now on, the clock does not jump. timekeeping_set() keeps it.
+void timekeeping_set_rate(int32_t ppb);
+int32_t timekeeping_get_rate(void);
+
+// Called after every timekeeping_set(), e.g. to realign timers to the new time. NULL to remove.
+typedef void (*timekeeping_callback_t)(void);
+void timekeeping_set_callback(timekeeping_callback_t callback);
+
+// True once the clock was set since boot
+bool timekeeping_is_set(void);
+
+// Time since boot, never jumps
+uint64_t timekeeping_monotonic_us(void);
+
+// UTC µs since 1970, now or at a given timer value
+int64_t timekeeping_realtime_us(void);
+int64_t timekeeping_realtime_at(uint64_t timerUs);
+
+// Timer value at which the clock reads utcUs
+uint64_t timekeeping_timer_at(int64_t utcUs);
+
+#ifdef __cplusplus
+}
+#endif
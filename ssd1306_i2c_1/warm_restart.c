@@ -0,0 +1,119 @@
+/* warm_restart.c
+ *
+ * The snapshot in RAM is only trusted when its checksum matches the one in watchdog scratch
+ * register 0, so neither RAM left over from an older run nor garbage after power-on is used.
+ * Scratch registers 4..7 belong to the SDK (watchdog_reboot()), 0..3 are free: 0 holds the checksum,
+ * 1 the low 32 bits of the timer at the last feed of the watchdog.
+ *
+ * A timeout resets the board WATCHDOG_TIMEOUT_MS after that feed, the gap since the snapshot is the
+ * difference of the two timer values (wrapping after 71 minutes does not matter for a few seconds).
+ * What is not measured is the reset itself and the start-up before the timer counts again.
+ */
+#include <string.h>
+
+#include "pico/time.h"
+#include "pico/platform.h"
+#include "hardware/watchdog.h"
+#include "hardware/sync.h"
+#include "timekeeping.h"
+#include "time_source.h"
+#include "holdover.h"
+#include "clock_discipline.h"
+#include "warm_restart.h"
+
+#define WARM_RESTART_MAGIC 0x57524D34   // "WRM4", change with the layout
+#define WARM_RESTART_BOOT_US 10000      // At most from the reset until the timer counts (oscillator start-up)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t error_us;      // Error bound of the clock at the snapshot
+    int64_t utc_us;
+    uint64_t timer_us;
+    int32_t rate_ppb;
+    bool rebooting;         // Saved right before a requested reboot, no time passed until the reset
+    holdover_model_t model;
+    clock_discipline_t discipline;
+} snapshot_t;
+
+// Not zeroed by the runtime at boot
+static snapshot_t __uninitialized_ram(snapshot);
+
+static time_source_t restartSource = { "restart", NULL, NULL, NULL };
+
+// FNV-1a, as used for the LED frames
+static uint32_t checksum(const snapshot_t *s)
+{
+    const uint8_t *p = (const uint8_t *)s;
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < sizeof(*s); i++)
+    {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void warm_restart_save(bool beforeReboot)
+{
+    if (!timekeeping_is_set())
+        return;
+
+    uint32_t irq = save_and_disable_interrupts();
+    snapshot.magic = WARM_RESTART_MAGIC;
+    snapshot.timer_us = time_us_64();
+    snapshot.utc_us = timekeeping_realtime_at(snapshot.timer_us);
+    snapshot.rate_ppb = timekeeping_get_rate();
+    snapshot.error_us = time_source_error_us();
+    snapshot.rebooting = beforeReboot;
+    snapshot.model = *holdover_model();
+    snapshot.discipline = *clock_discipline_state();
+    watchdog_hw->scratch[0] = checksum(&snapshot);
+    restore_interrupts(irq);
+}
+
+void warm_restart_feed(void)
+{
+    watchdog_hw->scratch[1] = (uint32_t)time_us_64();
+    watchdog_update();
+}
+
+void warm_restart_invalidate(void)
+{
+    watchdog_hw->scratch[0] = 0;
+    snapshot.magic = 0;
+}
+
+bool warm_restart_restore(void)
+{
+    if (!watchdog_caused_reboot() || snapshot.magic != WARM_RESTART_MAGIC || watchdog_hw->scratch[0] != checksum(&snapshot))
+        return false;
+
+    // Time from the snapshot to the reset. A timeout comes after the last feed, which was at most one
+    // loop (WARM_RESTART_INTERVAL_US) after the snapshot. Any other reset is not timed: no snapshot.
+    uint32_t gap = 0;
+    if (!snapshot.rebooting)
+    {
+        gap = watchdog_hw->scratch[1] + WATCHDOG_TIMEOUT_MS * 1000 - (uint32_t)snapshot.timer_us;
+        if (!watchdog_enable_caused_reboot() || gap > WATCHDOG_TIMEOUT_MS * 1000 + WARM_RESTART_INTERVAL_US)
+        {
+            warm_restart_invalidate();
+            return false;
+        }
+    }
+
+    // The timer counts from the reset (boot included), the start-up before it is half of its bound
+    uint64_t now = time_us_64();
+    int64_t utc = snapshot.utc_us + gap + WARM_RESTART_BOOT_US / 2 + (int64_t)now;
+    uint64_t error = (uint64_t)snapshot.error_us + WARM_RESTART_BOOT_US / 2;
+
+    // Drift since the snapshot adds to the error like in time_source_error_us()
+    error += (gap + now) * TIME_SOURCE_DRIFT_PPM / 1000000;
+
+    holdover_set_model(&snapshot.model);
+    clock_discipline_restore(&snapshot.discipline);
+    timekeeping_set_rate(snapshot.rate_ppb);
+    time_source_offer(&restartSource, utc, now, error > UINT32_MAX ? UINT32_MAX : (uint32_t)error);
+
+    // Used once, the next snapshot is made by the running clock
+    warm_restart_invalidate();
+    return true;
+}
@@ -0,0 +1,42 @@
+/* warm_restart.h
+ *
+ * Keeps the clock over watchdog and software resets.
+ *
+ * RAM and the watchdog scratch registers survive such a reset, the timer does not. Once per second
+ * the clock (UTC at a timer value), its rate correction, its error bound, the drift model and the
+ * NTP discipline (frequency, poll interval) are saved to a RAM section that the runtime does not
+ * zero, with a checksum in a scratch register.
+ * After the reset the time since the snapshot is the timer (it counts from the reset) plus the time
+ * between the snapshot and the reset. The watchdog fires exactly its timeout after it was last fed,
+ * so the feed time is kept in a scratch register too and gives that gap.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WARM_RESTART_INTERVAL_US 1000000    // Snapshot period
+#define WATCHDOG_TIMEOUT_MS 5000            // A hung loop is reset this long after its last snapshot
+
+// Saves the clock, call every WARM_RESTART_INTERVAL_US (e.g. on every tick).
+// beforeReboot: the reset follows right away, so no time is lost before it.
+void warm_restart_save(bool beforeReboot);
+
+// Feeds the watchdog and notes the time, call instead of watchdog_update()
+void warm_restart_feed(void);
+
+// Restores the clock after a warm reset, call first thing in main() after timekeeping_init()
+// and holdover_init(). Returns false after power-on, when the snapshot is not valid or when the
+// time of the reset is not known (a reboot nobody announced with warm_restart_save(true)).
+bool warm_restart_restore(void);
+
+// Snapshot is dropped, e.g. before flashing new firmware with a different layout
+void warm_restart_invalidate(void);
+
+#ifdef __cplusplus
+}
+#endif